@@ -0,0 +1,80 @@
+#include "adaptiveStep.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const int rungsPerOctave = 8;
+
+static float rungStep(const AdaptiveStepParams& params, int rung)
+{
+	return params.maxStep * std::exp2(-(float)rung / rungsPerOctave);
+}
+
+void AdaptiveStepController::reset(const Scene& scene)
+{
+	stableLimit = scene.getStableStep() * params.safety;
+	travelLimit = 0.0f;
+	errorLimit = 0.0f;
+	setRung(rungFor(stableLimit));
+	saveVelocities(scene);
+}
+
+float AdaptiveStepController::update(const Scene& scene, int steps)
+{
+	float elapsed = steps * step;
+	float maxSpeed = 0.0f, maxAccel = 0.0f;
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		const ParticleArrays& particles = cloth.getParticles();
+		glm::vec3* last = lastVel.data() + scene.getFirstPoint(c);
+		for (int i = 0; i < cloth.getNumPoints(); i++)
+		{
+			glm::vec3 vel = particles.vel(i);
+			maxSpeed = std::max(maxSpeed, glm::length(vel));
+			maxAccel = std::max(maxAccel, glm::length(vel - last[i]));
+			last[i] = vel;
+		}
+	}
+	maxAccel = elapsed > 0.0f ? maxAccel / elapsed : 0.0f;
+
+	stableLimit = scene.getStableStep() * params.safety;
+	travelLimit = maxSpeed > 0.0f ? params.maxTravel / maxSpeed : 0.0f;
+	errorLimit = maxAccel > 0.0f ? std::sqrt(2.0f * params.tolerance / maxAccel) : 0.0f;
+	int target = std::max(rungFor(stableLimit), std::max(rungFor(travelLimit), rungFor(errorLimit)));
+	// Down at once, up a rung at a time
+	setRung(target > rung ? target : std::max(target, rung - 1));
+	return step;
+}
+
+int AdaptiveStepController::rungFor(float limit) const
+{
+	int lowest = (int)std::floor(rungsPerOctave * std::log2(params.maxStep / params.minStep));
+	// NaN after a blow up gives the shortest step
+	if (limit != limit)
+		return lowest;
+	if (limit <= 0.0f || limit >= params.maxStep)
+		return 0;
+	int r = (int)std::ceil(rungsPerOctave * std::log2(params.maxStep / limit));
+	while (r < lowest && rungStep(params, r) > limit)
+		r++;
+	return std::min(std::max(r, 0), lowest);
+}
+
+void AdaptiveStepController::setRung(int newRung)
+{
+	rung = newRung;
+	step = rungStep(params, rung);
+}
+
+void AdaptiveStepController::saveVelocities(const Scene& scene)
+{
+	lastVel.resize(scene.getNumPoints());
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		const ParticleArrays& particles = cloth.getParticles();
+		for (int i = 0; i < cloth.getNumPoints(); i++)
+			lastVel[scene.getFirstPoint(c) + i] = particles.vel(i);
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef ADAPTIVE_STEP_H
+#define ADAPTIVE_STEP_H
+
+// Picks the step length from the state of the scene instead of one fixed
+// length safe for the worst case. Every few steps the controller takes the
+// shortest of three limits:
+//   stability - Verlet and explicit Euler blow up past a step set by the
+//               spring stiffness, damping and point mass (Cloth::getStableStep),
+//               run at a safety fraction of it. Implicit and XPBD have none.
+//   travel    - no point moves further than maxTravel in one step, so fast
+//               points don't skip through colliders
+//   error     - a step of h with acceleration a is off by about a h^2 / 2,
+//               kept under tolerance for the largest acceleration seen
+// A cloth hanging still has neither speed nor acceleration and only the
+// stability limit and maxStep are left, an impact shrinks the step at once.
+//
+// Steps only take the values maxStep * 2^(-n/8), so small changes in the
+// estimates don't change the step every time. It drops straight to the rung
+// the limits allow but only climbs one rung per estimate. Whoever steps the
+// scene calls Scene::changeStepLength when the step changes, see simThread.cpp.
+
+#include "scene.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct AdaptiveStepParams
+{
+	// bounds on the step, seconds
+	float minStep = 0.0001f;
+	float maxStep = 1.0f / 30.0f;
+	// fraction of the stable step to run explicit integrators at
+	float safety = 0.9f;
+	// furthest a point may move in one step, metres, a third of the colliders' buffer
+	float maxTravel = 0.01f;
+	// largest position error allowed per step, metres
+	float tolerance = 1e-4f;
+	// steps between estimates
+	int interval = 8;
+};
+
+class AdaptiveStepController
+{
+public:
+	AdaptiveStepParams params;
+
+	// Starts again from scene as it is now, with only the stability limit and
+	// maxStep. Call once the cloths are set up and when the integrator changes.
+	void reset(const Scene& scene);
+	// Estimates again after steps steps of getStep() since the last call or
+	// reset(), and returns the step to take next
+	float update(const Scene& scene, int steps);
+	float getStep() const { return step; }
+
+	// The limits found by the last estimate in seconds, 0 where there was none
+	float getStableLimit() const { return stableLimit; }
+	float getTravelLimit() const { return travelLimit; }
+	float getErrorLimit() const { return errorLimit; }
+
+private:
+	// Rung of the longest step within limit
+	int rungFor(float limit) const;
+	void setRung(int newRung);
+	void saveVelocities(const Scene& scene);
+
+	int rung = 0;
+	float step = 1.0f / 30.0f;
+	float stableLimit = 0.0f;
+	float travelLimit = 0.0f;
+	float errorLimit = 0.0f;
+	// Every point's velocity at the last estimate, numbered as in the scene
+	std::vector<glm::vec3> lastVel;
+};
+
+#endif
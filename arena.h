@@ -0,0 +1,85 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Bump allocator over one 64 byte aligned block. A cloth sizes and allocates
+// its arena once at setup and carves every per-cloth buffer out of it, so
+// stepping never touches the heap.
+//
+// The layout is written once and run twice: first against an arena with no
+// memory, which only adds up the sizes, then against the real block.
+//
+//   Arena sizing;
+//   layout(sizing);
+//   arena.reserve(sizing.getUsed());
+//   layout(arena);
+
+#include <cstddef>
+#include <cstdlib>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+class Arena
+{
+public:
+	static const size_t alignment = 64;
+
+	Arena() : base(nullptr), capacity(0), offset(0) {}
+	~Arena() { release(); }
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Makes sure there is a block of at least bytes and rewinds to its start.
+	// Anything carved out before is invalid afterwards.
+	bool reserve(size_t bytes)
+	{
+		offset = 0;
+		if (bytes <= capacity && base)
+			return true;
+		release();
+#if defined(_MSC_VER)
+		base = (char*)_aligned_malloc(bytes, alignment);
+#else
+		void* block = nullptr;
+		if (posix_memalign(&block, alignment, bytes) != 0)
+			block = nullptr;
+		base = (char*)block;
+#endif
+		capacity = base ? bytes : 0;
+		return base != nullptr;
+	}
+
+	void release()
+	{
+#if defined(_MSC_VER)
+		_aligned_free(base);
+#else
+		free(base);
+#endif
+		base = nullptr;
+		capacity = 0;
+		offset = 0;
+	}
+
+	// count values of T starting on a 64 byte boundary. Returns null when
+	// the arena has no block (sizing pass) or is full.
+	template <typename T>
+	T* alloc(size_t count)
+	{
+		size_t start = (offset + alignment - 1) & ~(alignment - 1);
+		offset = start + count * sizeof(T);
+		if (!base || offset > capacity)
+			return nullptr;
+		return reinterpret_cast<T*>(base + start);
+	}
+
+	size_t getUsed() const { return offset; }
+	size_t getCapacity() const { return capacity; }
+
+private:
+	char* base;
+	size_t capacity;
+	size_t offset;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CLOTH_H
+#define CLOTH_H
+
+// Interface shared by the runtime sized ClothSolver, the compile-time sized
+// ClothGrid and MultiresCloth, so a scene can step and draw any of them
+// without caring which one it has.
+
+#include "clothData.h"
+#include "clothParams.h"
+
+#include <cstddef>
+
+// Wall clock seconds spent in each phase of step(). The integrator's solve,
+// if it has one, counts as points.
+struct StepTimes
+{
+	double springs = 0.0;
+	double faces = 0.0;
+	double points = 0.0;
+	int steps = 0;
+};
+
+class Cloth
+{
+public:
+	virtual ~Cloth() {}
+
+	// Lay the cloth out flat and build its springs and faces, returns false
+	// if the cloth could not be set up
+	virtual bool init(const ClothParams& clothParams) = 0;
+	// Advance the simulation n times by dt
+	virtual void step(float dt, int n = 1) = 0;
+	// Longest step the integrator in use stays stable at, 0 if it is stable
+	// at any step
+	virtual float getStableStep() const = 0;
+	// Call when dt changes from from to to between steps. Keeps the velocity
+	// Verlet takes from the last two positions.
+	virtual void changeStepLength(float from, float to) = 0;
+	// Steps every part of the cloth again that sleeps, see
+	// ClothParams::sleeping. Call after changing parameters that would move
+	// a cloth at rest, e.g. gravity or the air.
+	virtual void wake() = 0;
+
+	// State accessors
+	virtual ClothParams& getParams() = 0;
+	virtual const ClothParams& getParams() const = 0;
+	virtual int getRows() const = 0;
+	virtual int getColumns() const = 0;
+	virtual int getNumPoints() const = 0;
+	virtual int getNumSprings() const = 0;
+	virtual int getNumFaces() const = 0;
+	// The particles in float, rounded from the cloth's own if it is more precise
+	virtual const ParticleArrays& getParticles() const = 0;
+	// Overwrites every particle array with state's, which must hold
+	// getNumPoints() points. Used to warm start from a snapshot.
+	virtual void setParticles(const ParticleArrays& state) = 0;
+	// Three indices per face, counter-clockwise
+	virtual const unsigned int* getIndices() const = 0;
+	// Writes every point's vertex to out, positions blended by alpha from
+	// before the last step (0) to now (1) for drawing between steps
+	virtual void writeVertices(float alpha, ClothVertex* out) const = 0;
+	virtual size_t getMemoryUsed() const = 0;
+	// Time spent stepping since the last resetStepTimes()
+	virtual const StepTimes& getStepTimes() const = 0;
+	virtual void resetStepTimes() = 0;
+};
+
+#endif
@@ -0,0 +1,257 @@
+// Cloth benchmarks --------------------
+//
+// Times each phase of a step (springs, face drag and normals, integration
+// and collision) and the whole step on its own, over cloth sizes from 30x30
+// to 1024x1024 and over thread counts. Reports time per particle and per
+// spring alongside the time per call, so sizes can be compared. Uses Google
+// Benchmark, e.g.
+//   g++ -O2 -std=c++14 -pthread -I<glm include dir> clothSolver.cpp clothSolverImplicit.cpp clothSolverSelf.cpp clothSolverSleep.cpp clothSolverXpbd.cpp colliders.cpp multiresCloth.cpp scene.cpp triangleBvh.cpp springKernels.cpp jobSystem.cpp clothBenchmark.cpp -lbenchmark -o clothBenchmark
+//
+// Benchmarks are named phase/size/threads, so e.g.
+//   clothBenchmark --benchmark_filter=Springs/256
+// runs the spring pass of a 256x256 cloth at every thread count.
+// Collide/n times the point pass of a 256x256 cloth over n props.
+// StepDouble is Step with ClothSolverDouble, StepMultires with a
+// MultiresCloth simulated one level coarser.
+// SceneStep/cloths/threads steps a scene of that many 32x32 grids.
+
+#include "clothGrid.h"
+#include "clothSolver.h"
+#include "colliders.h"
+#include "multiresCloth.h"
+#include "scene.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+// Steps taken before timing, so the points are already moving rather than
+// at rest where they were laid out
+static const int settleSteps = 20;
+static const float stepSize = 0.001f;
+
+// stepSize, or shorter where the cloth's integrator isn't stable at it.
+// Verlet at stepSize blows up from 64x64 on.
+template <typename Stepped>
+static float stepFor(const Stepped& stepped)
+{
+	float stable = stepped.getStableStep();
+	return stable > 0.0f ? std::min(stepSize, stable) : stepSize;
+}
+
+// Skips the benchmark if any point of cloth left the finite numbers
+static bool checkFinite(benchmark::State& state, const Cloth& cloth)
+{
+	const ParticleArrays& particles = cloth.getParticles();
+	for (int i = 0; i < cloth.getNumPoints(); i++)
+	{
+		if (!std::isfinite(particles.posX[i]) || !std::isfinite(particles.posY[i]) || !std::isfinite(particles.posZ[i]))
+		{
+			state.SkipWithError("Cloth blew up while settling");
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename Solver = ClothSolver>
+static std::unique_ptr<Solver> makeCloth(benchmark::State& state)
+{
+	ClothParams clothParams;
+	clothParams.rows = (int)state.range(0);
+	clothParams.columns = (int)state.range(0);
+	clothParams.threads = (int)state.range(1);
+	std::unique_ptr<Solver> cloth(new Solver());
+	if (!cloth->init(clothParams))
+	{
+		state.SkipWithError("Failed to set up cloth");
+		return nullptr;
+	}
+	cloth->step(stepFor(*cloth), settleSteps);
+	if (!checkFinite(state, *cloth))
+		return nullptr;
+	return cloth;
+}
+
+// Time per particle and per spring of each call
+static void setCounters(benchmark::State& state, const Cloth& cloth)
+{
+	const benchmark::Counter::Flags perItem =
+		benchmark::Counter::Flags(benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+	state.counters["particle"] = benchmark::Counter(cloth.getNumPoints(), perItem);
+	state.counters["spring"] = benchmark::Counter(cloth.getNumSprings(), perItem);
+}
+
+static void Springs(benchmark::State& state)
+{
+	std::unique_ptr<ClothSolver> cloth = makeCloth(state);
+	if (!cloth)
+		return;
+	for (auto _ : state)
+		cloth->springPass();
+	setCounters(state, *cloth);
+}
+
+static void Faces(benchmark::State& state)
+{
+	std::unique_ptr<ClothSolver> cloth = makeCloth(state);
+	if (!cloth)
+		return;
+	for (auto _ : state)
+		cloth->facePass();
+	setCounters(state, *cloth);
+}
+
+static void Points(benchmark::State& state)
+{
+	std::unique_ptr<ClothSolver> cloth = makeCloth(state);
+	if (!cloth)
+		return;
+	float dt = stepFor(*cloth);
+	for (auto _ : state)
+		cloth->pointPass(dt);
+	setCounters(state, *cloth);
+}
+
+static void Step(benchmark::State& state)
+{
+	std::unique_ptr<ClothSolver> cloth = makeCloth(state);
+	if (!cloth)
+		return;
+	float dt = stepFor(*cloth);
+	for (auto _ : state)
+		cloth->step(dt);
+	setCounters(state, *cloth);
+}
+
+// The whole step in double precision, against Step for what float saves
+static void StepDouble(benchmark::State& state)
+{
+	std::unique_ptr<ClothSolverDouble> cloth = makeCloth<ClothSolverDouble>(state);
+	if (!cloth)
+		return;
+	float dt = stepFor(*cloth);
+	for (auto _ : state)
+		cloth->step(dt);
+	setCounters(state, *cloth);
+}
+
+// The whole step simulated a level coarser, against Step for what filling in saves
+static void StepMultires(benchmark::State& state)
+{
+	std::unique_ptr<MultiresCloth> cloth = makeCloth<MultiresCloth>(state);
+	if (!cloth)
+		return;
+	float dt = stepFor(*cloth);
+	for (auto _ : state)
+		cloth->step(dt);
+	setCounters(state, *cloth);
+}
+
+// Point pass with state.range(0) props scattered over a 256x256 cloth
+static void Collide(benchmark::State& state)
+{
+	ColliderSet colliders;
+	int n = (int)state.range(0);
+	for (int i = 0; i < n; i++)
+	{
+		// A loose grid of props under the cloth
+		glm::vec3 pos(3.0f + 7.5f * (i % 16) / 16.0f, 1.0f + 0.5f * (i / 256), -1.5f + 4.5f * ((i / 16) % 16) / 16.0f);
+		if (i % 3 == 0)
+			colliders.addSphere(pos, 0.15f);
+		else if (i % 3 == 1)
+			colliders.addCapsule(pos, pos + glm::vec3(0.3f, 0.0f, 0.0f), 0.1f);
+		else
+			colliders.addBox(pos, glm::vec3(0.15f));
+	}
+	colliders.build();
+
+	ClothParams clothParams;
+	clothParams.rows = 256;
+	clothParams.columns = 256;
+	clothParams.threads = 1;
+	clothParams.colliders = &colliders;
+	ClothSolver cloth;
+	if (!cloth.init(clothParams))
+	{
+		state.SkipWithError("Failed to set up cloth");
+		return;
+	}
+	float dt = stepFor(cloth);
+	cloth.step(dt, settleSteps);
+	if (!checkFinite(state, cloth))
+		return;
+	for (auto _ : state)
+		cloth.pointPass(dt);
+	setCounters(state, cloth);
+}
+
+// Fixed size grids are single threaded, the thread count is ignored
+template <int Size>
+static void GridStep(benchmark::State& state)
+{
+	std::unique_ptr<ClothGrid<Size, Size>> cloth(new ClothGrid<Size, Size>());
+	cloth->init(ClothParams());
+	float dt = stepFor(*cloth);
+	cloth->step(dt, settleSteps);
+	if (!checkFinite(state, *cloth))
+		return;
+	for (auto _ : state)
+		cloth->step(dt);
+	setCounters(state, *cloth);
+}
+
+// state.range(0) small cloths side by side, stepped together on
+// state.range(1) threads
+static void SceneStep(benchmark::State& state)
+{
+	Scene scene((int)state.range(1));
+	for (int c = 0; c < state.range(0); c++)
+	{
+		ClothParams clothParams;
+		clothParams.origin.x += c * clothParams.scale * 2.5f;
+		if (!scene.add(std::unique_ptr<Cloth>(new ClothGrid<32, 32>()), clothParams))
+		{
+			state.SkipWithError("Failed to set up cloth");
+			return;
+		}
+	}
+	float dt = stepFor(scene);
+	scene.step(dt, settleSteps);
+	for (int c = 0; c < scene.getNumCloths(); c++)
+		if (!checkFinite(state, scene.getCloth(c)))
+			return;
+	for (auto _ : state)
+		scene.step(dt);
+
+	const benchmark::Counter::Flags perItem =
+		benchmark::Counter::Flags(benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+	state.counters["particle"] = benchmark::Counter(scene.getNumPoints(), perItem);
+	state.counters["spring"] = benchmark::Counter(scene.getNumSprings(), perItem);
+}
+
+// size x size cloths, each with 1 to 8 threads. Wall time, since the work
+// is spread over threads the main thread's CPU time says little.
+static void sizesAndThreads(benchmark::internal::Benchmark* b)
+{
+	b->ArgNames({ "size", "threads" });
+	b->ArgsProduct({ { 30, 64, 128, 256, 512, 1024 }, { 1, 2, 4, 8 } });
+	b->UseRealTime();
+	b->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK(Springs)->Apply(sizesAndThreads);
+BENCHMARK(Faces)->Apply(sizesAndThreads);
+BENCHMARK(Points)->Apply(sizesAndThreads);
+BENCHMARK(Step)->Apply(sizesAndThreads);
+BENCHMARK(StepDouble)->Apply(sizesAndThreads);
+BENCHMARK(StepMultires)->Apply(sizesAndThreads);
+BENCHMARK(Collide)->Arg(0)->Arg(16)->Arg(256)->Arg(1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(GridStep, 16)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(GridStep, 32)->Unit(benchmark::kMicrosecond);
+BENCHMARK(SceneStep)->ArgNames({ "cloths", "threads" })->ArgsProduct({ { 1, 8, 64 }, { 1, 2, 4, 8 } })
+	->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
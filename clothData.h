@@ -0,0 +1,230 @@
+#ifndef CLOTH_DATA_H
+#define CLOTH_DATA_H
+
+// Storage layout shared by the solver and its kernels. Particles and springs
+// are kept as structure-of-arrays: every component lives in its own 64 byte
+// aligned array so a kernel reads only the fields it needs and can load 8 or
+// 16 consecutive values with one instruction. The arrays are carved out of
+// the solver's arena (see arena.h) and sized at runtime.
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// Largest rows or columns a cloth may have
+const int maxGridSize = 4096;
+
+// Scalar is float in every cloth but the double precision solver, see
+// clothSolver.h
+template <typename Scalar>
+struct BasicParticleArrays
+{
+	typedef glm::tvec3<Scalar> Vec3;
+
+	Scalar* posX;
+	Scalar* posY;
+	Scalar* posZ;
+	Scalar* velX;
+	Scalar* velY;
+	Scalar* velZ;
+	Scalar* forceX;
+	Scalar* forceY;
+	Scalar* forceZ;
+	Scalar* normX;
+	Scalar* normY;
+	Scalar* normZ;
+	Scalar* prevX;
+	Scalar* prevY;
+	Scalar* prevZ;
+	Scalar* u;
+	Scalar* v;
+
+	Vec3 pos(int i) const { return Vec3(posX[i], posY[i], posZ[i]); }
+	Vec3 vel(int i) const { return Vec3(velX[i], velY[i], velZ[i]); }
+	Vec3 force(int i) const { return Vec3(forceX[i], forceY[i], forceZ[i]); }
+	Vec3 norm(int i) const { return Vec3(normX[i], normY[i], normZ[i]); }
+	Vec3 prevPos(int i) const { return Vec3(prevX[i], prevY[i], prevZ[i]); }
+	glm::vec2 uv(int i) const { return glm::vec2((float)u[i], (float)v[i]); }
+
+	void setPos(int i, const Vec3& p) { posX[i] = p.x; posY[i] = p.y; posZ[i] = p.z; }
+	void setVel(int i, const Vec3& p) { velX[i] = p.x; velY[i] = p.y; velZ[i] = p.z; }
+	void setForce(int i, const Vec3& p) { forceX[i] = p.x; forceY[i] = p.y; forceZ[i] = p.z; }
+	void setNorm(int i, const Vec3& p) { normX[i] = p.x; normY[i] = p.y; normZ[i] = p.z; }
+	void setPrevPos(int i, const Vec3& p) { prevX[i] = p.x; prevY[i] = p.y; prevZ[i] = p.z; }
+	void addForce(int i, const Vec3& f) { forceX[i] += f.x; forceY[i] += f.y; forceZ[i] += f.z; }
+};
+
+typedef BasicParticleArrays<float> ParticleArrays;
+
+// Every array of BasicParticleArrays, for code that treats them all alike
+const int numParticleFields = 17;
+template <typename Scalar>
+Scalar* BasicParticleArrays<Scalar>::* const particleFields[numParticleFields] =
+{
+	&BasicParticleArrays<Scalar>::posX, &BasicParticleArrays<Scalar>::posY, &BasicParticleArrays<Scalar>::posZ,
+	&BasicParticleArrays<Scalar>::velX, &BasicParticleArrays<Scalar>::velY, &BasicParticleArrays<Scalar>::velZ,
+	&BasicParticleArrays<Scalar>::forceX, &BasicParticleArrays<Scalar>::forceY, &BasicParticleArrays<Scalar>::forceZ,
+	&BasicParticleArrays<Scalar>::normX, &BasicParticleArrays<Scalar>::normY, &BasicParticleArrays<Scalar>::normZ,
+	&BasicParticleArrays<Scalar>::prevX, &BasicParticleArrays<Scalar>::prevY, &BasicParticleArrays<Scalar>::prevZ,
+	&BasicParticleArrays<Scalar>::u, &BasicParticleArrays<Scalar>::v
+};
+
+// Copies points begin .. end - 1 of every array, rounding if to is less precise
+template <typename From, typename To>
+void copyParticles(const BasicParticleArrays<From>& from, BasicParticleArrays<To>& to, int begin, int end)
+{
+	for (int f = 0; f < numParticleFields; f++)
+	{
+		const From* in = from.*particleFields<From>[f];
+		To* out = to.*particleFields<To>[f];
+		for (int i = begin; i < end; i++)
+			out[i] = (To)in[i];
+	}
+}
+
+// One vertex of the cloth as the renderer reads it, position and normal
+// interleaved so a frame's upload is one contiguous stream
+struct ClothVertex
+{
+	glm::vec3 pos;
+	glm::vec3 norm;
+};
+
+// Springs refer to their end points by index into ParticleArrays
+template <typename Scalar>
+struct BasicSpringArrays
+{
+	uint32_t* point1;
+	uint32_t* point2;
+	Scalar* restLen;
+	Scalar* k;
+	Scalar* vK;
+
+	// Lagrange multiplier of each spring's XPBD constraint, restarted every step
+	Scalar* lambda;
+
+	// Force each spring applies to point1 (point2 gets the negation),
+	// written by the spring kernels and then accumulated into the particles
+	Scalar* forceX;
+	Scalar* forceY;
+	Scalar* forceZ;
+};
+
+typedef BasicSpringArrays<float> SpringArrays;
+
+// Per-face results of the face pass. Each point then gathers from the faces
+// around it through a CSR adjacency, so no face writes to a point.
+template <typename Scalar>
+struct BasicFaceArrays
+{
+	// Share of the face's drag force each of its points gets
+	Scalar* dragX;
+	Scalar* dragY;
+	Scalar* dragZ;
+	// Unit face normal
+	Scalar* normX;
+	Scalar* normY;
+	Scalar* normZ;
+
+	// Faces around point i are faces[faceStart[i]] .. faces[faceStart[i + 1] - 1]
+	uint32_t* faceStart;
+	uint32_t* faces;
+};
+
+// Workspace of the implicit integrator, see clothSolverImplicit.cpp
+template <typename Scalar>
+struct BasicImplicitArrays
+{
+	// Velocity change being solved for
+	Scalar* dvX;
+	Scalar* dvY;
+	Scalar* dvZ;
+	// Conjugate gradient residual, search direction and system matrix times
+	// search direction
+	Scalar* rX;
+	Scalar* rY;
+	Scalar* rZ;
+	Scalar* pX;
+	Scalar* pY;
+	Scalar* pZ;
+	Scalar* qX;
+	Scalar* qY;
+	Scalar* qZ;
+	// Inverse of the system matrix diagonal, the Jacobi preconditioner
+	Scalar* invDiagX;
+	Scalar* invDiagY;
+	Scalar* invDiagZ;
+
+	// Symmetric 3x3 Jacobian block of every spring, h^2 * dF/dx + h * dF/dv
+	Scalar* jXX;
+	Scalar* jXY;
+	Scalar* jXZ;
+	Scalar* jYY;
+	Scalar* jYZ;
+	Scalar* jZZ;
+
+	// Two partial dot products per block of points
+	double* partial;
+};
+
+// Self collision push of every point, see clothSolverSelf.cpp
+template <typename Scalar>
+struct BasicSelfCollisionArrays
+{
+	// Contacts a point keeps the face's side of, any more only push the point
+	static const int maxContacts = 4;
+
+	Scalar* pushX;
+	Scalar* pushY;
+	Scalar* pushZ;
+	// Contact k of point i is at i * maxContacts + k: the face, the push its
+	// corners take between them and the weights of corners b and c in it
+	uint8_t* numContacts;
+	uint32_t* contactFace;
+	Scalar* reactX;
+	Scalar* reactY;
+	Scalar* reactZ;
+	Scalar* weightB;
+	Scalar* weightC;
+	// Row and column of the quad each face is half of
+	int* faceRow;
+	int* faceCol;
+};
+
+// Sleep state of the tiles a cloth is split into, see clothSolverSleep.cpp
+struct SleepArrays
+{
+	// Steps in a row the tile's points all moved slower than sleepSpeed
+	int32_t* calmSteps;
+	// 1 while the tile sleeps
+	uint8_t* tileAsleep;
+	// 1 if a point of the awake tile moved fast enough to wake its neighbours
+	// in the last step
+	uint8_t* tileMoving;
+	// 1 if a collider moved near the sleeping tile in the last step
+	uint8_t* tileDisturbed;
+	// Box around a sleeping tile's points
+	float* loX;
+	float* loY;
+	float* loZ;
+	float* hiX;
+	float* hiY;
+	float* hiZ;
+	// 1 while the point's tile sleeps
+	uint8_t* pointAsleep;
+
+	// Springs are sorted by the tile of point1 within each color. The springs
+	// of color c in tile t are runStart[(c * numTiles + t) * 2] .. + 1 for
+	// those with both points in t, then up to + 2 for those reaching into a
+	// neighbouring tile.
+	uint32_t* runStart;
+
+	// Rebuilt whenever a tile falls asleep or wakes: the awake tiles, the
+	// sleeping tiles next to one, and the ranges of springs to run, as begin
+	// and end pairs, color c's being runs colorRunStart[c] .. [c + 1] - 1
+	uint32_t* awakeTiles;
+	uint32_t* borderTiles;
+	uint32_t* springRuns;
+	uint32_t* colorRunStart;
+};
+
+#endif
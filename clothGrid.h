@@ -0,0 +1,387 @@
+#ifndef CLOTH_GRID_H
+#define CLOTH_GRID_H
+
+// Fixed size cloth for the small sizes we use by the thousand (banners,
+// 16x16 and 32x32 patches). The whole topology is known at compile time:
+// point, face and per type spring counts and face indices are constexpr and
+// the neighbours of a point are fixed offsets. The springs of one direction
+// are one strip of points, so the spring kernel loads them where
+// ClothSolver's gathers them, and the edges of the grid are split from the
+// inside at compile time, so the inner loops have no bounds checks. Springs
+// follow the same directions as ClothSolver's, see clothTopology.h.
+//
+// The default pins, the pole down column 0, are skipped at compile time too.
+// params.pins and whether shear and bend springs are used stay run time
+// settings, so cloths of one size can hang differently (the demo's banners
+// hang by two corners); a cloth with its own pins checks a mask per point.
+//
+// Runs single threaded, many small cloths are stepped in parallel instead.
+// Only the explicit integrators are supported, INTEGRATOR_IMPLICIT and
+// INTEGRATOR_XPBD step with Verlet, and selfCollision and sleeping are
+// ignored.
+// Has the same interface as ClothSolver. params.rows and params.columns are
+// ignored, Rows and Cols decide the size.
+
+#include "cloth.h"
+#include "clothPhysics.h"
+#include "clothTopology.h"
+#include "arena.h"
+#include "lapTimer.h"
+#include "springKernels.h"
+
+#include <cmath>
+#include <memory>
+#include <new>
+
+template <int Rows, int Cols>
+class ClothGrid : public Cloth
+{
+	static_assert(Rows >= 2 && Cols >= 2, "A cloth needs at least 2x2 points");
+
+public:
+	static constexpr int numPoints = Rows * Cols;
+	static constexpr int numQuads = (Rows - 1) * (Cols - 1);
+	static constexpr int numFaces = numQuads * 2;
+	// Springs of each type, see countSprings
+	static constexpr int numStructuralSprings = Rows * (Cols - 1) + (Rows - 1) * Cols;
+	static constexpr int numShearSprings = (Rows - 1) * (Cols - 1) * 2;
+	static constexpr int numBendSprings = Rows * (Cols - 2) + (Rows - 2) * Cols;
+
+
+	struct FaceIndexTable
+	{
+		unsigned int v[numFaces * 3];
+	};
+	static constexpr FaceIndexTable makeFaceIndices()
+	{
+		FaceIndexTable t{};
+		for (int i = 0; i < Rows - 1; i++)
+		{
+			for (int j = 0; j < Cols - 1; j++)
+			{
+				// Wind counter-clockwise, same as ClothSolver
+				int index = (i * (Cols - 1) + j) * 6;
+
+				t.v[index] = (i)* Cols + (j);
+				t.v[index + 1] = (i + 1) * Cols + (j);
+				t.v[index + 2] = (i + 1) * Cols + (j + 1);
+
+				t.v[index + 3] = (i)* Cols + (j);
+				t.v[index + 4] = (i + 1)* Cols + (j + 1);
+				t.v[index + 5] = (i)* Cols + (j + 1);
+			}
+		}
+		return t;
+	}
+	static constexpr FaceIndexTable faceIndices = makeFaceIndices();
+
+	// The arrays are 64 byte aligned, which plain new does not promise before C++17
+	static void* operator new(size_t size)
+	{
+		std::unique_ptr<Arena> block(new Arena());
+		if (!block->reserve(size + Arena::alignment))
+			throw std::bad_alloc();
+		// Keep the arena just in front of the object so delete can find it
+		void* memory = block->alloc<char>(size + Arena::alignment);
+		*(Arena**)memory = block.release();
+		return (char*)memory + Arena::alignment;
+	}
+	static void operator delete(void* memory)
+	{
+		if (memory)
+			delete *(Arena**)((char*)memory - Arena::alignment);
+	}
+
+	ClothGrid()
+	{
+		particles.posX = posX; particles.posY = posY; particles.posZ = posZ;
+		particles.velX = velX; particles.velY = velY; particles.velZ = velZ;
+		particles.forceX = forceX; particles.forceY = forceY; particles.forceZ = forceZ;
+		particles.normX = normX; particles.normY = normY; particles.normZ = normZ;
+		particles.prevX = prevX; particles.prevY = prevY; particles.prevZ = prevZ;
+		particles.u = u; particles.v = v;
+	}
+
+	bool init(const ClothParams& clothParams) override
+	{
+		for (int pin : clothParams.pins)
+			if (pin < 0 || pin >= numPoints)
+				return false;
+		params = clothParams;
+		params.rows = Rows;
+		params.columns = Cols;
+		clothMass = params.flagMass / numPoints;
+		springStrip = getSpringStripKernel(params.simd);
+		stepTimes = StepTimes();
+
+		// initialize points, same layout as ClothSolver
+		for (int i = 0; i < Rows; i++)
+		{
+			for (int j = 0; j < Cols; j++)
+			{
+				int index = i * Cols + j;
+				particles.setPos(index, flatPosition(params, Rows, Cols, i, j));
+				particles.setPrevPos(index, particles.pos(index));
+				particles.setVel(index, glm::vec3(0.0f));
+				particles.setForce(index, glm::vec3(0.0f));
+				u[index] = i / (float)Rows;
+				v[index] = j / (float)Cols;
+				particles.setNorm(index, glm::vec3(0.0f, 0.0f, 1.0f));
+			}
+		}
+		// Hold the pins still, the pole by default
+		polePinned = params.pins.empty();
+		for (int i = 0; i < numPoints; i++)
+			pinMask[i] = polePinned && i % Cols == 0;
+		for (int pin : params.pins)
+			pinMask[pin] = 1;
+
+		// The grid is regular, so one rest length per direction
+		for (int d = 0; d < numSpringDirections; d++)
+		{
+			int di = springDirections[d].di, dj = springDirections[d].dj;
+			int first = dj < 0 ? -dj : 0;
+			restLen[d] = glm::length(particles.pos(first) - particles.pos(di * Cols + first + dj));
+		}
+		return true;
+	}
+
+	void step(float dt, int n = 1) override
+	{
+		LapTimer timer;
+		for (int s = 0; s < n; s++)
+		{
+			springPass();
+			stepTimes.springs += timer.lap();
+			facePass();
+			stepTimes.faces += timer.lap();
+			pointPass(dt);
+			stepTimes.points += timer.lap();
+		}
+		stepTimes.steps += n;
+	}
+
+	// Always Verlet or explicit Euler
+	float getStableStep() const override { return explicitStableStep(params, clothMass); }
+
+	void changeStepLength(float from, float to) override
+	{
+		float ratio = to / from;
+		for (int i = 0; i < numPoints; i++)
+			particles.setPrevPos(i, rescalePrevPos(particles.pos(i), particles.prevPos(i), ratio));
+	}
+	// Every point is stepped every step, nothing ever sleeps
+	void wake() override {}
+
+	// State accessors
+	ClothParams& getParams() override { return params; }
+	const ClothParams& getParams() const override { return params; }
+	int getRows() const override { return Rows; }
+	int getColumns() const override { return Cols; }
+	int getNumPoints() const override { return numPoints; }
+	int getNumSprings() const override
+	{
+		return numStructuralSprings + (params.shearSprings ? numShearSprings : 0) + (params.bendSprings ? numBendSprings : 0);
+	}
+	int getNumFaces() const override { return numFaces; }
+	const ParticleArrays& getParticles() const override { return particles; }
+	void setParticles(const ParticleArrays& state) override { copyParticles(state, particles, 0, numPoints); }
+	const unsigned int* getIndices() const override { return faceIndices.v; }
+	void writeVertices(float alpha, ClothVertex* out) const override { writeClothVertices(particles, 0, numPoints, alpha, out); }
+	size_t getMemoryUsed() const override { return sizeof(*this); }
+	const StepTimes& getStepTimes() const override { return stepTimes; }
+	void resetStepTimes() override { stepTimes = StepTimes(); }
+
+private:
+	bool pinned(int i) const { return pinMask[i] != 0; }
+
+	void springPass()
+	{
+		springDirection<0, 1>(0);
+		springDirection<1, 0>(1);
+		springDirection<1, 1>(2);
+		springDirection<1, -1>(3);
+		springDirection<0, 2>(4);
+		springDirection<2, 0>(5);
+	}
+
+	// Springs of direction d run from every point p to p + Di * Cols + Dj,
+	// so they are one strip of points with no index arrays. The strip runs
+	// on from the end of one row to the start of the next, across springs
+	// that don't exist, which are always the same columns and are zeroed.
+	// Then both ends take their forces in two plain loops.
+	template <int Di, int Dj>
+	void springDirection(int d)
+	{
+		SpringType type = springDirections[d].type;
+		if (!springTypeUsed(params, type))
+			return;
+		constexpr int offset = Di * Cols + Dj;
+		constexpr int first = Dj < 0 ? -Dj : 0;
+		constexpr int last = (Rows - Di) * Cols - (Dj > 0 ? Dj : 0);
+		springStrip(particles, first, last, offset, restLen[d], springStiffness(params, type), springDamping(params, type),
+			springX, springY, springZ);
+
+		// The last Dj columns of every row but the last, or the first -Dj of
+		// every row but the first
+		constexpr int zeroRowBegin = Dj < 0 ? 1 : 0;
+		constexpr int zeroRowEnd = Dj < 0 ? Rows - Di : Rows - Di - 1;
+		constexpr int zeroColumnBegin = Dj > 0 ? Cols - Dj : 0;
+		constexpr int zeroColumnEnd = Dj > 0 ? Cols : -Dj;
+		for (int i = zeroRowBegin; i < zeroRowEnd; i++)
+			for (int j = zeroColumnBegin; j < zeroColumnEnd; j++)
+			{
+				int p = i * Cols + j;
+				springX[p] = 0.0f; springY[p] = 0.0f; springZ[p] = 0.0f;
+			}
+
+		for (int p = first; p < last; p++)
+		{
+			forceX[p] += springX[p];
+			forceY[p] += springY[p];
+			forceZ[p] += springZ[p];
+		}
+		for (int p = first; p < last; p++)
+		{
+			forceX[p + offset] -= springX[p];
+			forceY[p + offset] -= springY[p];
+			forceZ[p + offset] -= springZ[p];
+		}
+	}
+
+	void facePass()
+	{
+		// Drag share and normal of every face
+		float dragOn = params.drag ? 1.0f : 0.0f;
+		for (int f = 0; f < numFaces; f++)
+		{
+			int i1 = faceIndices.v[f * 3], i2 = faceIndices.v[f * 3 + 1], i3 = faceIndices.v[f * 3 + 2];
+			glm::vec3 n;
+			glm::vec3 drag = faceDrag(params, particles.pos(i1), particles.pos(i2), particles.pos(i3),
+				particles.vel(i1), particles.vel(i2), particles.vel(i3), n) / 3.0f;
+			faceDragShare[f] = drag * dragOn;
+			faceNormal[f] = n;
+		}
+
+		// Every point pulls from the up to six faces it is on. Quad q holds
+		// faces 2q and 2q + 1, see makeFaceIndices. Inner points are on all
+		// six, only the edges need checking.
+		for (int i = 1; i < Rows - 1; i++)
+			for (int j = 1; j < Cols - 1; j++)
+			{
+				int below = (i * (Cols - 1) + j) * 2;
+				int above = below - (Cols - 1) * 2;
+				glm::vec3 drag = faceDragShare[below] + faceDragShare[below + 1] + faceDragShare[above] +
+					faceDragShare[below - 1] + faceDragShare[above - 2] + faceDragShare[above - 1];
+				glm::vec3 norm = faceNormal[below] + faceNormal[below + 1] + faceNormal[above] +
+					faceNormal[below - 1] + faceNormal[above - 2] + faceNormal[above - 1];
+				int p = i * Cols + j;
+				particles.addForce(p, drag);
+				particles.setNorm(p, finishNormal(norm));
+			}
+		for (int j = 0; j < Cols; j++)
+		{
+			gatherEdge(0, j);
+			gatherEdge(Rows - 1, j);
+		}
+		for (int i = 1; i < Rows - 1; i++)
+		{
+			gatherEdge(i, 0);
+			gatherEdge(i, Cols - 1);
+		}
+	}
+
+	void gatherEdge(int i, int j)
+	{
+		glm::vec3 drag(0.0f), norm(0.0f);
+		if (i < Rows - 1 && j < Cols - 1)
+			gatherFace((i * (Cols - 1) + j) * 2, 2, drag, norm);
+		if (i > 0 && j < Cols - 1)
+			gatherFace(((i - 1) * (Cols - 1) + j) * 2, 1, drag, norm);
+		if (i < Rows - 1 && j > 0)
+			gatherFace((i * (Cols - 1) + j - 1) * 2 + 1, 1, drag, norm);
+		if (i > 0 && j > 0)
+			gatherFace(((i - 1) * (Cols - 1) + j - 1) * 2, 2, drag, norm);
+		int p = i * Cols + j;
+		particles.addForce(p, drag);
+		particles.setNorm(p, finishNormal(norm));
+	}
+
+	void gatherFace(int first, int count, glm::vec3& drag, glm::vec3& norm) const
+	{
+		for (int f = first; f < first + count; f++)
+		{
+			drag += faceDragShare[f];
+			norm += faceNormal[f];
+		}
+	}
+
+	void pointPass(float dt)
+	{
+		if (polePinned)
+		{
+			for (int i = 0; i < Rows; i++)
+				for (int j = 1; j < Cols; j++)
+					movePoint(i * Cols + j, dt);
+			return;
+		}
+		for (int i = 0; i < numPoints; i++)
+			if (!pinned(i))
+				movePoint(i, dt);
+	}
+
+	void movePoint(int i, float dt)
+	{
+		glm::vec3 pos = particles.pos(i);
+		glm::vec3 vel = particles.vel(i);
+		glm::vec3 prevPos = particles.prevPos(i);
+		integratePoint(params, clothMass, dt, particles.force(i), pos, vel, prevPos);
+		collidePoint(params, pos, vel);
+
+		particles.setPos(i, pos);
+		particles.setVel(i, vel);
+		particles.setPrevPos(i, prevPos);
+		particles.setForce(i, glm::vec3(0.0f));
+	}
+
+	ClothParams params;
+	float clothMass;
+	// No params.pins, column 0 is held and pointPass skips it without the mask
+	bool polePinned;
+	float restLen[numSpringDirections];
+	SpringStripKernel springStrip;
+	StepTimes stepTimes;
+	ParticleArrays particles;
+
+	alignas(64) float posX[numPoints];
+	alignas(64) float posY[numPoints];
+	alignas(64) float posZ[numPoints];
+	alignas(64) float velX[numPoints];
+	alignas(64) float velY[numPoints];
+	alignas(64) float velZ[numPoints];
+	alignas(64) float forceX[numPoints];
+	alignas(64) float forceY[numPoints];
+	alignas(64) float forceZ[numPoints];
+	alignas(64) float normX[numPoints];
+	alignas(64) float normY[numPoints];
+	alignas(64) float normZ[numPoints];
+	alignas(64) float prevX[numPoints];
+	alignas(64) float prevY[numPoints];
+	alignas(64) float prevZ[numPoints];
+	alignas(64) float u[numPoints];
+	alignas(64) float v[numPoints];
+	uint8_t pinMask[numPoints];
+
+	// Spring forces on the first point of each spring, one direction at a time
+	alignas(64) float springX[numPoints];
+	alignas(64) float springY[numPoints];
+	alignas(64) float springZ[numPoints];
+
+	glm::vec3 faceDragShare[numFaces];
+	glm::vec3 faceNormal[numFaces];
+};
+
+template <int Rows, int Cols>
+constexpr typename ClothGrid<Rows, Cols>::FaceIndexTable ClothGrid<Rows, Cols>::faceIndices;
+
+#endif
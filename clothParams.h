@@ -0,0 +1,97 @@
+#ifndef CLOTH_PARAMS_H
+#define CLOTH_PARAMS_H
+
+#include "springKernels.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class ColliderSet;
+class JobSystem;
+
+enum Integrator
+{
+	INTEGRATOR_VERLET,  // position Verlet
+	INTEGRATOR_EULER,   // explicit Euler
+	INTEGRATOR_IMPLICIT, // backward Euler solved by conjugate gradient, ClothSolver only
+	INTEGRATOR_XPBD      // springs as compliant distance constraints, ClothSolver only
+};
+
+// Everything that can be tuned about the cloth and the scene it lives in
+struct ClothParams
+{
+	// cloth size, up to maxGridSize each way
+	int rows = 30;
+	int columns = 30;
+
+	// cloth physics
+	float clothK = 4.00f;
+	float dampK = 0.09f;
+	// shear (cross) springs join diagonal neighbours, bend springs join points
+	// two apart along a row or column, see clothTopology.h
+	bool shearSprings = true;
+	float crossClothK = 9.0f;
+	float crossDampK = 0.02f;
+	bool bendSprings = true;
+	float bendK = 1.0f;
+	float bendDampK = 0.01f;
+	float flagMass = 0.244f; //Actual mass of flag in kg/m2, shared evenly by the points
+	float airDensity = 1.0f; // Actual density is 1.225 kg/m3 apparently
+	float clothDragCoef = 0.01f;
+	glm::vec3 airVel = glm::vec3(0.0f, 0.0f, 0.001f);
+	bool drag = true;
+
+	glm::vec3 grav = glm::vec3(0.0f, -9.8f, 0.0f);
+	Integrator integrator = INTEGRATOR_VERLET;
+	// implicit integrator, conjugate gradient stops after cgIterations or once
+	// the residual has shrunk by cgTolerance
+	int cgIterations = 40;
+	float cgTolerance = 1e-3f;
+	// XPBD, constraint passes per step
+	int xpbdIterations = 10;
+	// self collision, ClothSolver only. Points are kept selfThickness times
+	// the shortest spring away from the cloth's other triangles.
+	bool selfCollision = false;
+	float selfThickness = 0.25f;
+	// sleeping, ClothSolver only and not with the implicit integrator. The
+	// cloth is split into tiles of sleepTile by sleepTile points. A tile
+	// whose points all move slower than sleepSpeed (m/s) for sleepSteps steps
+	// in a row stops being stepped until a moving neighbour tile or a collider
+	// moving near it wakes it, see clothSolverSleep.cpp.
+	bool sleeping = false;
+	int sleepTile = 8;
+	float sleepSpeed = 0.05f;
+	int sleepSteps = 300;
+	// multiresolution, MultiresCloth only. The cloth is simulated on a grid
+	// 2^multiresLevel times coarser each way and the points in between are
+	// filled in, then kept out of the colliders by multiresIterations
+	// correction passes, see multiresCloth.h.
+	int multiresLevel = 1;
+	int multiresIterations = 2;
+
+	// widest instruction set the spring pass may use, lowered to what the CPU supports
+	SimdLevel simd = SIMD_AVX512;
+	// threads stepping the cloth, 0 for one per hardware thread
+	int threads = 0;
+	// pool to run on instead of the cloth's own threads, not owned. Lets a
+	// Scene step many cloths on one set of threads.
+	JobSystem* jobs = nullptr;
+	// most springs, faces or points handed to a thread at once
+	int grainSize = 1024;
+
+	// size of the flag in the initial layout, and where its first point starts
+	float scale = 4.0f;
+	glm::vec3 origin = glm::vec3(3.0f, 6.0f, 3.0f);
+	// points held in place, empty pins the first column to the pole
+	std::vector<int> pins;
+
+	// Sphere
+	float sphereR = 2.0f;
+	glm::vec3 spherePos = glm::vec3(3.0f, 2.0f, -3.0f);
+	// Props besides the floor and the sphere, not owned. Built by whoever
+	// moves them, before stepping.
+	const ColliderSet* colliders = nullptr;
+};
+
+#endif
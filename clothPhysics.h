@@ -0,0 +1,157 @@
+#ifndef CLOTH_PHYSICS_H
+#define CLOTH_PHYSICS_H
+
+// Per-face and per-point physics shared by ClothSolver and ClothGrid, so both
+// move the cloth the same way whatever their storage looks like.
+
+#include "clothData.h"
+#include "clothParams.h"
+#include "clothTopology.h"
+#include "colliders.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// Scalar is float for every cloth but the double precision solver. The
+// parameters are float either way and are widened where they meet Scalar.
+
+// Drag on a face, the face normal is returned through n
+// f = -1/2p*length(v)*DragCoef*area*normal
+template <typename Scalar>
+inline glm::tvec3<Scalar> faceDrag(const ClothParams& params,
+	const glm::tvec3<Scalar>& p1, const glm::tvec3<Scalar>& p2, const glm::tvec3<Scalar>& p3,
+	const glm::tvec3<Scalar>& v1, const glm::tvec3<Scalar>& v2, const glm::tvec3<Scalar>& v3, glm::tvec3<Scalar>& n)
+{
+	typedef glm::tvec3<Scalar> Vec3;
+	// v is velocity of face - velocity of the air
+	Vec3 v = (v1 + v2 + v3) / Scalar(3) + Vec3(params.airVel);
+	// use cross product and normalize to get n
+	Vec3 cross = glm::cross((p1 - p2), (p1 - p3));
+	n = glm::normalize(cross);
+	// area of face is half of the area of parallelogram, dot this with velocity to get area exposed to flow
+	Scalar a = glm::dot((Scalar(0.5) * cross), glm::normalize(v));
+	// put all together to get drag
+	return Scalar(-0.5) * Scalar(params.airDensity) * glm::length(v) * Scalar(params.clothDragCoef) * a * n;
+}
+
+// Moves a free point by the forces on it with one of the explicit integrators
+template <typename Scalar>
+inline void integratePoint(const ClothParams& params, Scalar mass, Scalar dt, const glm::tvec3<Scalar>& force,
+	glm::tvec3<Scalar>& pos, glm::tvec3<Scalar>& vel, glm::tvec3<Scalar>& prevPos)
+{
+	typedef glm::tvec3<Scalar> Vec3;
+	// Gravity
+	Vec3 forces = force + Vec3(params.grav) * mass;
+
+	// Now integrate forces
+	Vec3 accel = forces / mass;
+	// Integrate velocity
+	if (params.integrator == INTEGRATOR_EULER)
+	{
+		prevPos = pos;
+		pos += vel * dt;
+		vel += accel * dt;
+	}
+	else
+	{
+		vel += accel * dt;
+		Vec3 temp = prevPos;
+		prevPos = pos;
+		pos = Scalar(2) * pos - temp + accel * dt*dt;
+	}
+}
+
+// The colliders work in float. A more precise point only goes through them
+// rounded, and only takes the rounded values back if they moved it.
+inline void collideWithProps(const ColliderSet& colliders, glm::vec3& pos, glm::vec3& vel)
+{
+	colliders.collide(pos, vel);
+}
+
+template <typename Scalar>
+inline void collideWithProps(const ColliderSet& colliders, glm::tvec3<Scalar>& pos, glm::tvec3<Scalar>& vel)
+{
+	glm::vec3 p(pos), v(vel);
+	glm::vec3 before = p, velBefore = v;
+	colliders.collide(p, v);
+	if (p != before || v != velBefore)
+	{
+		pos = glm::tvec3<Scalar>(p);
+		vel = glm::tvec3<Scalar>(v);
+	}
+}
+
+// Longest step Verlet or explicit Euler stays stable at, for points of mass
+// mass joined by the springs of params. A point and its springs are taken as
+// one damped oscillator with the stiffness k and damping c of every spring a
+// point can have, which is stable while h^2 k/m + 2 h c/m < 4. Returns 0 if
+// the cloth has no springs to limit the step.
+inline float explicitStableStep(const ClothParams& params, float mass)
+{
+	double k = 0.0, c = 0.0;
+	for (const SpringDirection& d : springDirections)
+	{
+		// A point is at either end of a direction's springs
+		if (springTypeUsed(params, d.type))
+		{
+			k += 2.0 * springStiffness(params, d.type);
+			c += 2.0 * springDamping(params, d.type);
+		}
+	}
+	if (k <= 0.0)
+		return c > 0.0 ? (float)(2.0 * mass / c) : 0.0f;
+	double w2 = k / mass, g = c / mass;
+	return (float)((std::sqrt(g * g + 4.0 * w2) - g) / w2);
+}
+
+// Moves the previous position of a point so Verlet takes the same velocity
+// from it after the step length changes by ratio
+template <typename Scalar>
+inline glm::tvec3<Scalar> rescalePrevPos(const glm::tvec3<Scalar>& pos, const glm::tvec3<Scalar>& prevPos, Scalar ratio)
+{
+	return pos - (pos - prevPos) * ratio;
+}
+
+// Pushes a point out of the floor, the sphere and any other colliders
+template <typename Scalar>
+inline void collidePoint(const ClothParams& params, glm::tvec3<Scalar>& pos, glm::tvec3<Scalar>& vel)
+{
+	typedef glm::tvec3<Scalar> Vec3;
+	if (pos[1] < Scalar(0.01f))
+	{
+		pos[1] = Scalar(0.01f);
+		vel[1] = Scalar(vel[1] * -0.95);
+	}
+	Vec3 spherePos(params.spherePos);
+	Vec3 off = (pos - spherePos);
+	Scalar reach = Scalar(params.sphereR + 0.03f);
+	if (glm::length(off) < reach)
+	{
+		pos = spherePos + normalize(off)*reach;
+		vel = glm::reflect(vel, normalize(off));
+	}
+	if (params.colliders)
+		collideWithProps(*params.colliders, pos, vel);
+}
+
+// Vertices of points begin .. end - 1 for drawing, alpha blends each point
+// from where it was before the last step (0) to where it is now (1)
+inline void writeClothVertices(const ParticleArrays& particles, int begin, int end, float alpha, ClothVertex* out)
+{
+	for (int i = begin; i < end; i++)
+	{
+		out[i].pos = glm::mix(particles.prevPos(i), particles.pos(i), alpha);
+		out[i].norm = particles.norm(i);
+	}
+}
+
+// Normal of a point from the sum of the normals of the faces around it
+template <typename Scalar>
+inline glm::tvec3<Scalar> finishNormal(const glm::tvec3<Scalar>& summed)
+{
+	glm::tvec3<Scalar> norm = summed + glm::tvec3<Scalar>(Scalar(0), Scalar(0), Scalar(0.01f));
+	return norm / glm::length(norm);
+}
+
+#endif
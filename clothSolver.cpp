@@ -0,0 +1,415 @@
+#include "clothSolver.h"
+
+#include "clothPhysics.h"
+#include "clothTopology.h"
+#include "lapTimer.h"
+
+#include <algorithm>
+#include <type_traits>
+
+// A float cloth is its own float view, any other keeps a rounded copy
+static void layoutView(Arena&, ParticleArrays& particles, ParticleArrays& view, int)
+{
+	view = particles;
+}
+
+template <typename Scalar>
+static void layoutView(Arena& memory, BasicParticleArrays<Scalar>&, ParticleArrays& view, int numPoints)
+{
+	for (int f = 0; f < numParticleFields; f++)
+		view.*particleFields<float>[f] = memory.alloc<float>(numPoints);
+}
+
+// The wide kernels are float only
+static SimdLevel chooseSpringKernel(SimdLevel wanted, SpringKernel& kernel)
+{
+	SimdLevel supported = detectSimdLevel();
+	SimdLevel level = wanted < supported ? wanted : supported;
+	kernel = getSpringKernel(level);
+	return level;
+}
+
+template <typename Scalar>
+static SimdLevel chooseSpringKernel(SimdLevel,
+	void(*&kernel)(const BasicParticleArrays<Scalar>&, BasicSpringArrays<Scalar>&, int, int))
+{
+	kernel = springForcesPortable<Scalar>;
+	return SIMD_SCALAR;
+}
+
+template <typename Scalar>
+bool BasicClothSolver<Scalar>::init(const ClothParams& clothParams)
+{
+	if (clothParams.rows < 2 || clothParams.columns < 2 ||
+		clothParams.rows > maxGridSize || clothParams.columns > maxGridSize)
+		return false;
+	for (int pin : clothParams.pins)
+		if (pin < 0 || pin >= clothParams.rows * clothParams.columns)
+			return false;
+
+	params = clothParams;
+	rows = params.rows;
+	columns = params.columns;
+	numPoints = rows * columns;
+	numSprings = countSprings(params, rows, columns);
+	numFaces = (rows - 1) * (columns - 1) * 2;
+	clothMass = (Scalar)params.flagMass / numPoints;
+
+	// Size everything, then allocate it in one go
+	Arena sizing;
+	layout(sizing);
+	if (!arena.reserve(sizing.getUsed()))
+		return false;
+	layout(arena);
+
+	simdLevel = chooseSpringKernel(params.simd, springKernel);
+	if (params.jobs)
+		jobs = params.jobs;
+	else
+	{
+		if (!ownJobs || (params.threads > 0 && params.threads != ownJobs->getThreadCount()))
+			ownJobs.reset(new JobSystem(params.threads));
+		jobs = ownJobs.get();
+	}
+	implicitReady = false;
+	selfReady = false;
+	sleepReady = false;
+	numAsleep = 0;
+	solverIterations = 0;
+	stepTimes = StepTimes();
+	if (params.integrator == INTEGRATOR_IMPLICIT && !reserveImplicit())
+		return false;
+
+	// initialize points
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < columns; j++)
+		{
+			// Inital cloth points
+			int index = i * columns + j;
+			particles.setPos(index, Vec3(flatPosition(params, rows, columns, i, j)));
+			particles.setPrevPos(index, particles.pos(index));
+			particles.setVel(index, Vec3(Scalar(0)));
+			particles.setForce(index, Vec3(Scalar(0)));
+			particles.u[index] = i / (float)rows;
+			particles.v[index] = j / (float)columns;
+			particles.setNorm(index, Vec3(Scalar(0), Scalar(0), Scalar(1)));
+		}
+	}
+	// Hold the pins still, the pole by default
+	for (int i = 0; i < numPoints; i++)
+		pinned[i] = params.pins.empty() && i % columns == 0;
+	for (int pin : params.pins)
+		pinned[pin] = 1;
+
+	// initialize springs
+	buildSprings(params, rows, columns, springs);
+	springsColored = colorSprings(springs, numSprings, numPoints, numSpringColors, springColorStart);
+	measureRestLengths();
+
+	// Set up indices for rendering and the face pass
+	for (int i = 0; i < rows - 1; i++)
+	{
+		for (int j = 0; j < columns - 1; j++)
+		{
+			// Wind counter-clockwise
+			int index = (i * (columns - 1) + j) * 6;
+
+			clothIndices[index] = (i)* columns + (j);
+			clothIndices[index + 1] = (i + 1) * columns + (j);
+			clothIndices[index + 2] = (i + 1) * columns + (j + 1);
+
+			clothIndices[index + 3] = (i)* columns + (j);
+			clothIndices[index + 4] = (i + 1)* columns + (j + 1);
+			clothIndices[index + 5] = (i)* columns + (j + 1);
+		}
+	}
+	buildFaceAdjacency();
+	updateView();
+	return true;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::layout(Arena& memory)
+{
+	particles.posX = memory.alloc<Scalar>(numPoints);
+	particles.posY = memory.alloc<Scalar>(numPoints);
+	particles.posZ = memory.alloc<Scalar>(numPoints);
+	particles.velX = memory.alloc<Scalar>(numPoints);
+	particles.velY = memory.alloc<Scalar>(numPoints);
+	particles.velZ = memory.alloc<Scalar>(numPoints);
+	particles.forceX = memory.alloc<Scalar>(numPoints);
+	particles.forceY = memory.alloc<Scalar>(numPoints);
+	particles.forceZ = memory.alloc<Scalar>(numPoints);
+	particles.normX = memory.alloc<Scalar>(numPoints);
+	particles.normY = memory.alloc<Scalar>(numPoints);
+	particles.normZ = memory.alloc<Scalar>(numPoints);
+	particles.prevX = memory.alloc<Scalar>(numPoints);
+	particles.prevY = memory.alloc<Scalar>(numPoints);
+	particles.prevZ = memory.alloc<Scalar>(numPoints);
+	particles.u = memory.alloc<Scalar>(numPoints);
+	particles.v = memory.alloc<Scalar>(numPoints);
+	layoutView(memory, particles, view, numPoints);
+
+	springs.point1 = memory.alloc<uint32_t>(numSprings);
+	springs.point2 = memory.alloc<uint32_t>(numSprings);
+	springs.restLen = memory.alloc<Scalar>(numSprings);
+	springs.k = memory.alloc<Scalar>(numSprings);
+	springs.vK = memory.alloc<Scalar>(numSprings);
+	springs.lambda = memory.alloc<Scalar>(numSprings);
+	springs.forceX = memory.alloc<Scalar>(numSprings);
+	springs.forceY = memory.alloc<Scalar>(numSprings);
+	springs.forceZ = memory.alloc<Scalar>(numSprings);
+
+	clothIndices = memory.alloc<unsigned int>(numFaces * 3);
+	pinned = memory.alloc<uint8_t>(numPoints);
+
+	faces.dragX = memory.alloc<Scalar>(numFaces);
+	faces.dragY = memory.alloc<Scalar>(numFaces);
+	faces.dragZ = memory.alloc<Scalar>(numFaces);
+	faces.normX = memory.alloc<Scalar>(numFaces);
+	faces.normY = memory.alloc<Scalar>(numFaces);
+	faces.normZ = memory.alloc<Scalar>(numFaces);
+	faces.faceStart = memory.alloc<uint32_t>(numPoints + 1);
+	faces.faces = memory.alloc<uint32_t>(numFaces * 3);
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::step(float dt, int n)
+{
+	LapTimer timer;
+	// The implicit solve takes the whole cloth at once, nothing sleeps with it
+	bool sleeping = params.sleeping && params.integrator != INTEGRATOR_IMPLICIT && reserveSleep();
+	if (!sleeping)
+		wake();
+	for (int s = 0; s < n; s++)
+	{
+		// The springs are constraints rather than forces with XPBD
+		if (params.integrator != INTEGRATOR_XPBD)
+			springPass();
+		stepTimes.springs += timer.lap();
+		facePass();
+		stepTimes.faces += timer.lap();
+		if (params.integrator == INTEGRATOR_XPBD)
+			xpbdStep(dt);
+		// Falls back to Verlet if the implicit workspace can't be allocated
+		else if (params.integrator == INTEGRATOR_IMPLICIT && reserveImplicit())
+			implicitStep(dt);
+		else
+			pointPass(dt);
+		if (params.selfCollision && reserveSelfCollision())
+			selfCollide();
+		if (sleeping)
+			updateSleep(dt);
+		stepTimes.points += timer.lap();
+	}
+	updateView();
+	stepTimes.points += timer.lap();
+	stepTimes.steps += n;
+}
+
+template <typename Scalar>
+float BasicClothSolver<Scalar>::getStableStep() const
+{
+	if (params.integrator == INTEGRATOR_IMPLICIT || params.integrator == INTEGRATOR_XPBD)
+		return 0.0f;
+	return explicitStableStep(params, (float)clothMass);
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::changeStepLength(float from, float to)
+{
+	Scalar ratio = (Scalar)to / from;
+	jobs->parallelFor(0, numPoints, params.grainSize, [this, ratio](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			particles.setPrevPos(i, rescalePrevPos(particles.pos(i), particles.prevPos(i), ratio));
+	});
+	updateView();
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::updateView()
+{
+	if (std::is_same<Scalar, float>::value)
+		return;
+	jobs->parallelFor(0, numPoints, params.grainSize,
+		[this](int begin, int end) { copyParticles(particles, view, begin, end); });
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::setParticles(const ParticleArrays& state)
+{
+	wake();
+	copyParticles(state, particles, 0, numPoints);
+	updateView();
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::measureRestLengths()
+{
+	for (int s = 0; s < numSprings; s++)
+		springs.restLen[s] = glm::length(particles.pos(springs.point1[s]) - particles.pos(springs.point2[s]));
+	shortestSpring = springs.restLen[0];
+	for (int s = 1; s < numSprings; s++)
+		shortestSpring = std::min(shortestSpring, springs.restLen[s]);
+}
+
+// List the faces around each point, in face order
+template <typename Scalar>
+void BasicClothSolver<Scalar>::buildFaceAdjacency()
+{
+	for (int i = 0; i <= numPoints; i++)
+		faces.faceStart[i] = 0;
+	for (int k = 0; k < numFaces * 3; k++)
+		faces.faceStart[clothIndices[k] + 1]++;
+	for (int i = 0; i < numPoints; i++)
+		faces.faceStart[i + 1] += faces.faceStart[i];
+
+	std::vector<uint32_t> next(faces.faceStart, faces.faceStart + numPoints);
+	for (int f = 0; f < numFaces; f++)
+		for (int k = 0; k < 3; k++)
+			faces.faces[next[clothIndices[f * 3 + k]]++] = f;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::forEachSpringColor(const RangeFunction& fn)
+{
+	// One color at a time. Springs of a color share no points, so each point
+	// gets its share in the same order however a color is split up.
+	if (!springsColored)
+	{
+		fn(0, numSprings);
+		return;
+	}
+	if (numAsleep > 0)
+	{
+		// Only the ranges next to awake points, see clothSolverSleep.cpp
+		const uint32_t* runs = sleepState.springRuns;
+		for (int c = 0; c < numSpringColors; c++)
+			jobs->parallelFor(sleepState.colorRunStart[c], sleepState.colorRunStart[c + 1], runGrain, [runs, &fn](int begin, int end)
+			{
+				for (int r = begin; r < end; r++)
+					fn(runs[r * 2], runs[r * 2 + 1]);
+			});
+		return;
+	}
+	for (int c = 0; c < numSpringColors; c++)
+		jobs->parallelFor(springColorStart[c], springColorStart[c + 1], params.grainSize, fn);
+}
+
+// Process for each spring
+template <typename Scalar>
+void BasicClothSolver<Scalar>::springPass()
+{
+	forEachSpringColor([this](int begin, int end) { springBatch(begin, end); });
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::springBatch(int begin, int end)
+{
+	// Spring and damping forces, 8 or 16 springs at a time
+	springKernel(particles, springs, begin, end);
+
+	// Apply the force to both points each spring is connected to
+	for (int i = begin; i < end; i++)
+	{
+		uint32_t a = springs.point1[i];
+		uint32_t b = springs.point2[i];
+		particles.forceX[a] += springs.forceX[i];
+		particles.forceY[a] += springs.forceY[i];
+		particles.forceZ[a] += springs.forceZ[i];
+		particles.forceX[b] -= springs.forceX[i];
+		particles.forceY[b] -= springs.forceY[i];
+		particles.forceZ[b] -= springs.forceZ[i];
+	}
+}
+
+// Process each face, then gather the results to the points. Each face and
+// each point only writes its own data, so neither needs coloring.
+template <typename Scalar>
+void BasicClothSolver<Scalar>::facePass()
+{
+	forEachAwakeFace([this](int begin, int end) { faceBatch(begin, end); });
+	forEachAwakePoint([this](int begin, int end) { gatherBatch(begin, end); });
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::faceBatch(int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		// Get points for each point on face
+		unsigned int i1 = clothIndices[i * 3];
+		unsigned int i2 = clothIndices[i * 3 + 1];
+		unsigned int i3 = clothIndices[i * 3 + 2];
+		Vec3 n;
+		Vec3 dragForce = faceDrag(params, particles.pos(i1), particles.pos(i2), particles.pos(i3),
+			particles.vel(i1), particles.vel(i2), particles.vel(i3), n);
+		// Each point on face gets 1/3 of force
+		Vec3 share = params.drag ? dragForce / Scalar(3) : Vec3(Scalar(0));
+		faces.dragX[i] = share.x;
+		faces.dragY[i] = share.y;
+		faces.dragZ[i] = share.z;
+		faces.normX[i] = n.x;
+		faces.normY[i] = n.y;
+		faces.normZ[i] = n.z;
+	}
+}
+
+// Drag from and normal of every face around a point. The normal is rebuilt
+// from scratch every step.
+template <typename Scalar>
+void BasicClothSolver<Scalar>::gatherBatch(int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		Vec3 drag(Scalar(0)), norm(Scalar(0));
+		for (uint32_t k = faces.faceStart[i]; k < faces.faceStart[i + 1]; k++)
+		{
+			uint32_t f = faces.faces[k];
+			drag += Vec3(faces.dragX[f], faces.dragY[f], faces.dragZ[f]);
+			norm += Vec3(faces.normX[f], faces.normY[f], faces.normZ[f]);
+		}
+		particles.addForce(i, drag);
+		particles.setNorm(i, finishNormal(norm));
+	}
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::writeVertices(float alpha, ClothVertex* out) const
+{
+	jobs->parallelFor(0, numPoints, params.grainSize,
+		[this, alpha, out](int begin, int end) { writeClothVertices(view, begin, end, alpha, out); });
+}
+
+// Process each non-fixed point
+template <typename Scalar>
+void BasicClothSolver<Scalar>::pointPass(float dt)
+{
+	forEachAwakePoint([this, dt](int begin, int end) { pointBatch(begin, end, dt); });
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::pointBatch(int begin, int end, Scalar dt)
+{
+	for (int i = begin; i < end; i++)
+	{
+		if (!isPinned(i))
+		{
+			Vec3 pos = particles.pos(i);
+			Vec3 vel = particles.vel(i);
+			Vec3 prevPos = particles.prevPos(i);
+			integratePoint(params, clothMass, dt, particles.force(i), pos, vel, prevPos);
+			collidePoint(params, pos, vel);
+
+			particles.setPos(i, pos);
+			particles.setVel(i, vel);
+			particles.setPrevPos(i, prevPos);
+			particles.setForce(i, Vec3(Scalar(0)));
+		}
+	}
+}
+
+template class BasicClothSolver<float>;
+template class BasicClothSolver<double>;
@@ -0,0 +1,203 @@
+#ifndef CLOTH_SOLVER_H
+#define CLOTH_SOLVER_H
+
+// Cloth simulation core. Has no OpenGL or window dependencies so it can be
+// stepped headless (see headless.cpp) as well as from the render loop.
+//
+// The solver is templated on the precision it simulates in. ClothSolver is
+// the float one everything runs by default. ClothSolverDouble does the same
+// math in double, for telling instability of the model apart from float
+// round-off (headless --compare runs both side by side). Its spring pass uses
+// the portable kernel, the AVX ones are float only, and the colliders other
+// than the floor and sphere still work in float. getParticles() is a float
+// copy of its state, refreshed after every step().
+//
+// With params.sleeping, tiles of the cloth that have come to rest stop being
+// stepped, see clothSolverSleep.cpp.
+
+#include "arena.h"
+#include "cloth.h"
+#include "clothData.h"
+#include "colliders.h"
+#include "coloring.h"
+#include "jobSystem.h"
+#include "springKernels.h"
+#include "triangleBvh.h"
+
+template <typename Scalar>
+class BasicClothSolver : public Cloth
+{
+public:
+	typedef glm::tvec3<Scalar> Vec3;
+	typedef BasicParticleArrays<Scalar> Particles;
+	typedef BasicSpringArrays<Scalar> Springs;
+
+	// Lay the cloth out flat and build its springs and faces. All buffers
+	// are allocated here, returns false if the size is out of range or the
+	// memory is not available.
+	bool init(const ClothParams& clothParams) override;
+	// Advance the simulation n times by dt
+	void step(float dt, int n = 1) override;
+	// Implicit and XPBD are stable at any step
+	float getStableStep() const override;
+	void changeStepLength(float from, float to) override;
+	void wake() override;
+
+	// State accessors
+	ClothParams& getParams() override { return params; }
+	const ClothParams& getParams() const override { return params; }
+	int getRows() const override { return rows; }
+	int getColumns() const override { return columns; }
+	int getNumPoints() const override { return numPoints; }
+	int getNumSprings() const override { return numSprings; }
+	int getNumFaces() const override { return numFaces; }
+	size_t getMemoryUsed() const override
+	{
+		return arena.getUsed() + (implicitReady ? implicitArena.getUsed() : 0) + (selfReady ? selfArena.getUsed() : 0) +
+			(sleepReady ? sleepArena.getUsed() : 0);
+	}
+	const ParticleArrays& getParticles() const override { return view; }
+	void setParticles(const ParticleArrays& state) override;
+	// Takes every spring's rest length from where the points are now, for a
+	// cloth whose rest shape isn't the flat grid init() lays out
+	void measureRestLengths();
+	const unsigned int* getIndices() const override { return clothIndices; }
+	void writeVertices(float alpha, ClothVertex* out) const override;
+	const StepTimes& getStepTimes() const override { return stepTimes; }
+	void resetStepTimes() override { stepTimes = StepTimes(); }
+	Scalar getPointMass() const { return clothMass; }
+	// The particles in the cloth's own precision
+	const Particles& getExactParticles() const { return particles; }
+	const Springs& getSprings() const { return springs; }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+	// Springs are sorted by color, color c is springs colorStart[c] .. colorStart[c + 1] - 1
+	int getNumSpringColors() const { return numSpringColors; }
+	const int* getSpringColorStart() const { return springColorStart; }
+	int getThreadCount() const { return jobs->getThreadCount(); }
+	// Conjugate gradient iterations taken by the last implicit step
+	int getSolverIterations() const { return solverIterations; }
+	// Tiles the cloth is split into for sleeping, 0 until sleeping is first
+	// used, and how many of them sleep
+	int getNumTiles() const { return sleepReady ? numTiles : 0; }
+	int getNumAsleep() const { return numAsleep; }
+
+	// The three phases of an explicit step, each split into ranges run on the
+	// job system. step() runs them in order, they are public so the
+	// benchmarks can time them one by one.
+	void springPass();
+	void facePass();
+	void pointPass(float dt);
+
+private:
+	// Carves every per-cloth buffer out of the arena
+	void layout(Arena& memory);
+	// Rounds the particles into view, if it isn't them
+	void updateView();
+	void buildFaceAdjacency();
+	bool isPinned(int i) const { return pinned[i] != 0; }
+	// Runs fn over the springs one color at a time
+	void forEachSpringColor(const RangeFunction& fn);
+	// Run fn over the points or faces that need stepping, every one of them
+	// while no tile sleeps
+	void forEachAwakePoint(const RangeFunction& fn);
+	void forEachAwakeFace(const RangeFunction& fn);
+
+	void springBatch(int begin, int end);
+	void faceBatch(int begin, int end);
+	void gatherBatch(int begin, int end);
+	void pointBatch(int begin, int end, Scalar dt);
+
+	// Backward Euler, see clothSolverImplicit.cpp
+	bool reserveImplicit();
+	void layoutImplicit(Arena& memory);
+	void implicitStep(Scalar dt);
+	void blockSums(const std::function<void(int block, int begin, int end)>& fn, double& sum0, double& sum1);
+	void jacobianBatch(int begin, int end, Scalar dt);
+	void systemBatch(int begin, int end);
+
+	// Position based, see clothSolverXpbd.cpp
+	void xpbdStep(Scalar dt);
+	void constraintBatch(int begin, int end, Scalar dt);
+
+	// Self collision, see clothSolverSelf.cpp
+	bool reserveSelfCollision();
+	void layoutSelfCollision(Arena& memory);
+	void selfCollide();
+	void pushBatch(int begin, int end, Scalar thickness);
+	bool isNearFace(int row, int col, uint32_t f) const;
+
+	// Sleeping, see clothSolverSleep.cpp
+	bool reserveSleep();
+	void layoutSleep(Arena& memory);
+	void sortSpringsByTile();
+	void updateSleep(Scalar dt);
+	void watchColliders();
+	void disturbTiles(const glm::vec3& lo, const glm::vec3& hi);
+	void putTileToSleep(int t);
+	void wakeTile(int t);
+	void buildAwakeLists();
+	bool isAsleep(int i) const { return numAsleep > 0 && sleepState.pointAsleep[i] != 0; }
+	int tileOf(int i) const { return (i / columns) / tileSize * tileColumns + (i % columns) / tileSize; }
+	// True if a tile next to t, not t itself, passes test
+	template <typename Test>
+	bool anyNeighbour(int t, Test test) const;
+
+	ClothParams params;
+	int rows, columns;
+	int numPoints, numSprings, numFaces;
+	Scalar clothMass;
+	StepTimes stepTimes;
+
+	Arena arena;
+	Particles particles;
+	// particles itself when Scalar is float, otherwise a rounded copy
+	ParticleArrays view;
+	Springs springs;
+	unsigned int* clothIndices;
+	uint8_t* pinned;
+
+	int numSpringColors;
+	int springColorStart[maxColors + 1];
+	// false if the springs needed more than maxColors colors, then they are one serial batch
+	bool springsColored;
+
+	BasicFaceArrays<Scalar> faces;
+
+	// Only allocated once the implicit integrator is first used
+	Arena implicitArena;
+	BasicImplicitArrays<Scalar> implicit;
+	bool implicitReady;
+	int solverIterations;
+
+	// Only allocated and built once self collision is first used
+	Arena selfArena;
+	BasicTriangleBvh<Scalar> bvh;
+	BasicSelfCollisionArrays<Scalar> self;
+	bool selfReady;
+	Scalar shortestSpring;
+
+	// Only allocated once sleeping is first used
+	Arena sleepArena;
+	SleepArrays sleepState;
+	bool sleepReady;
+	int tileSize, tileRows, tileColumns, numTiles;
+	int numAsleep;
+	int numAwakeTiles, numBorderTiles;
+	// Spring ranges handed to a thread at once, about grainSize springs
+	int runGrain;
+	// The sphere and props as they were last step, to tell when they move
+	glm::vec3 lastSpherePos;
+	float lastSphereR;
+	std::vector<Collider> lastColliders;
+
+	SimdLevel simdLevel;
+	void(*springKernel)(const Particles& particles, Springs& springs, int begin, int end);
+	// params.jobs if set, otherwise threads of our own
+	std::unique_ptr<JobSystem> ownJobs;
+	JobSystem* jobs = nullptr;
+};
+
+typedef BasicClothSolver<float> ClothSolver;
+typedef BasicClothSolver<double> ClothSolverDouble;
+
+#endif
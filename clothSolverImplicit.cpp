@@ -0,0 +1,333 @@
+// Backward Euler integrator (Baraff and Witkin, Large Steps in Cloth
+// Simulation). Explicit integration blows up once dt gets near the period of
+// the stiffest spring, so the solver is stuck with tiny steps. Taking the
+// forces at the end of the step instead stays stable at frame sized steps.
+//
+// Linearizing the forces around the current state gives one linear system
+// per step for the velocity change dv:
+//
+//   (M - h dF/dv - h^2 dF/dx) dv = h (F + h dF/dx v)
+//
+// The matrix has one 3x3 block per spring (plus the mass on the diagonal),
+// so it is never assembled: the blocks are kept per spring and the system is
+// solved with Jacobi preconditioned conjugate gradient, applying the matrix
+// spring by spring in the same color batches as the spring pass. Pinned
+// points are filtered out by keeping their residual and search direction at
+// zero, so their dv stays zero.
+//
+// Only springs are linearized. Drag and gravity go in as constant forces and
+// collisions are resolved after the solve, the same way as the explicit
+// integrators.
+
+#include "clothSolver.h"
+
+#include "clothPhysics.h"
+
+#include <cmath>
+
+// Points per block of a dot product. Fixed, so the partial sums and the order
+// they are added in don't depend on the thread count.
+static const int reductionBlock = 2048;
+
+template <typename Scalar>
+bool BasicClothSolver<Scalar>::reserveImplicit()
+{
+	if (implicitReady)
+		return true;
+	Arena sizing;
+	layoutImplicit(sizing);
+	if (!implicitArena.reserve(sizing.getUsed()))
+		return false;
+	layoutImplicit(implicitArena);
+	implicitReady = true;
+	return true;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::layoutImplicit(Arena& memory)
+{
+	implicit.dvX = memory.alloc<Scalar>(numPoints);
+	implicit.dvY = memory.alloc<Scalar>(numPoints);
+	implicit.dvZ = memory.alloc<Scalar>(numPoints);
+	implicit.rX = memory.alloc<Scalar>(numPoints);
+	implicit.rY = memory.alloc<Scalar>(numPoints);
+	implicit.rZ = memory.alloc<Scalar>(numPoints);
+	implicit.pX = memory.alloc<Scalar>(numPoints);
+	implicit.pY = memory.alloc<Scalar>(numPoints);
+	implicit.pZ = memory.alloc<Scalar>(numPoints);
+	implicit.qX = memory.alloc<Scalar>(numPoints);
+	implicit.qY = memory.alloc<Scalar>(numPoints);
+	implicit.qZ = memory.alloc<Scalar>(numPoints);
+	implicit.invDiagX = memory.alloc<Scalar>(numPoints);
+	implicit.invDiagY = memory.alloc<Scalar>(numPoints);
+	implicit.invDiagZ = memory.alloc<Scalar>(numPoints);
+
+	implicit.jXX = memory.alloc<Scalar>(numSprings);
+	implicit.jXY = memory.alloc<Scalar>(numSprings);
+	implicit.jXZ = memory.alloc<Scalar>(numSprings);
+	implicit.jYY = memory.alloc<Scalar>(numSprings);
+	implicit.jYZ = memory.alloc<Scalar>(numSprings);
+	implicit.jZZ = memory.alloc<Scalar>(numSprings);
+
+	implicit.partial = memory.alloc<double>(((numPoints + reductionBlock - 1) / reductionBlock) * 2);
+}
+
+// Runs fn over the points in fixed blocks, block b writes its two partial
+// sums to partial[b * 2] and partial[b * 2 + 1]. They are added up in block
+// order so the result is the same for any thread count.
+template <typename Scalar>
+void BasicClothSolver<Scalar>::blockSums(const std::function<void(int block, int begin, int end)>& fn, double& sum0, double& sum1)
+{
+	int numBlocks = (numPoints + reductionBlock - 1) / reductionBlock;
+	int grain = params.grainSize / reductionBlock;
+	jobs->parallelFor(0, numBlocks, grain, [this, &fn](int begin, int end)
+	{
+		for (int b = begin; b < end; b++)
+		{
+			int last = (b + 1) * reductionBlock;
+			fn(b, b * reductionBlock, last < numPoints ? last : numPoints);
+		}
+	});
+
+	sum0 = 0.0;
+	sum1 = 0.0;
+	for (int b = 0; b < numBlocks; b++)
+	{
+		sum0 += implicit.partial[b * 2];
+		sum1 += implicit.partial[b * 2 + 1];
+	}
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::implicitStep(Scalar dt)
+{
+	BasicImplicitArrays<Scalar>& w = implicit;
+	Scalar mass = clothMass;
+
+	// Right hand side starts as h * F, the springs add their h^2 dF/dx v part
+	// below. The diagonal starts as the mass.
+	jobs->parallelFor(0, numPoints, params.grainSize, [this, &w, mass, dt](int begin, int end)
+	{
+		Vec3 grav = Vec3(params.grav) * mass;
+		for (int i = begin; i < end; i++)
+		{
+			bool free = !isPinned(i);
+			w.rX[i] = free ? dt * (particles.forceX[i] + grav.x) : 0.0f;
+			w.rY[i] = free ? dt * (particles.forceY[i] + grav.y) : 0.0f;
+			w.rZ[i] = free ? dt * (particles.forceZ[i] + grav.z) : 0.0f;
+			w.invDiagX[i] = mass;
+			w.invDiagY[i] = mass;
+			w.invDiagZ[i] = mass;
+			w.dvX[i] = 0.0f;
+			w.dvY[i] = 0.0f;
+			w.dvZ[i] = 0.0f;
+			w.pX[i] = 0.0f;
+			w.pY[i] = 0.0f;
+			w.pZ[i] = 0.0f;
+		}
+	});
+	forEachSpringColor([this, dt](int begin, int end) { jacobianBatch(begin, end, dt); });
+
+	// Pinned points keep a zero residual, so nothing ever moves them
+	double rz, rr;
+	blockSums([this, &w](int block, int begin, int end)
+	{
+		double sumRZ = 0.0, sumRR = 0.0;
+		for (int i = begin; i < end; i++)
+		{
+			w.invDiagX[i] = 1.0f / w.invDiagX[i];
+			w.invDiagY[i] = 1.0f / w.invDiagY[i];
+			w.invDiagZ[i] = 1.0f / w.invDiagZ[i];
+			if (isPinned(i))
+			{
+				w.rX[i] = 0.0f;
+				w.rY[i] = 0.0f;
+				w.rZ[i] = 0.0f;
+			}
+			sumRZ += w.rX[i] * w.rX[i] * w.invDiagX[i] + w.rY[i] * w.rY[i] * w.invDiagY[i] + w.rZ[i] * w.rZ[i] * w.invDiagZ[i];
+			sumRR += w.rX[i] * w.rX[i] + w.rY[i] * w.rY[i] + w.rZ[i] * w.rZ[i];
+		}
+		w.partial[block * 2] = sumRZ;
+		w.partial[block * 2 + 1] = sumRR;
+	}, rz, rr);
+
+	double tolerance = (double)params.cgTolerance * params.cgTolerance * rr;
+	Scalar beta = 0.0f;
+	int iteration = 0;
+	while (iteration < params.cgIterations && rr > tolerance)
+	{
+		// p = z + beta p, then q = A p. The mass part of A is done here, the
+		// springs add theirs afterwards.
+		jobs->parallelFor(0, numPoints, params.grainSize, [this, &w, mass, beta](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				w.pX[i] = w.rX[i] * w.invDiagX[i] + beta * w.pX[i];
+				w.pY[i] = w.rY[i] * w.invDiagY[i] + beta * w.pY[i];
+				w.pZ[i] = w.rZ[i] * w.invDiagZ[i] + beta * w.pZ[i];
+				w.qX[i] = mass * w.pX[i];
+				w.qY[i] = mass * w.pY[i];
+				w.qZ[i] = mass * w.pZ[i];
+			}
+		});
+		forEachSpringColor([this](int begin, int end) { systemBatch(begin, end); });
+
+		// p is zero on pinned points, so they add nothing here
+		double pq, unused;
+		blockSums([&w](int block, int begin, int end)
+		{
+			double sum = 0.0;
+			for (int i = begin; i < end; i++)
+				sum += w.pX[i] * w.qX[i] + w.pY[i] * w.qY[i] + w.pZ[i] * w.qZ[i];
+			w.partial[block * 2] = sum;
+			w.partial[block * 2 + 1] = 0.0;
+		}, pq, unused);
+		if (pq <= 0.0)
+			break;
+
+		Scalar alpha = (Scalar)(rz / pq);
+		double rzNew;
+		blockSums([this, &w, alpha](int block, int begin, int end)
+		{
+			double sumRZ = 0.0, sumRR = 0.0;
+			for (int i = begin; i < end; i++)
+			{
+				if (isPinned(i))
+					continue;
+				w.dvX[i] += alpha * w.pX[i];
+				w.dvY[i] += alpha * w.pY[i];
+				w.dvZ[i] += alpha * w.pZ[i];
+				w.rX[i] -= alpha * w.qX[i];
+				w.rY[i] -= alpha * w.qY[i];
+				w.rZ[i] -= alpha * w.qZ[i];
+				sumRZ += w.rX[i] * w.rX[i] * w.invDiagX[i] + w.rY[i] * w.rY[i] * w.invDiagY[i] + w.rZ[i] * w.rZ[i] * w.invDiagZ[i];
+				sumRR += w.rX[i] * w.rX[i] + w.rY[i] * w.rY[i] + w.rZ[i] * w.rZ[i];
+			}
+			w.partial[block * 2] = sumRZ;
+			w.partial[block * 2 + 1] = sumRR;
+		}, rzNew, rr);
+
+		beta = (Scalar)(rzNew / rz);
+		rz = rzNew;
+		iteration++;
+	}
+	solverIterations = iteration;
+
+	// New velocity, then move with it. prevPos is kept up to date for drawing
+	// between steps and so the integrator can be switched back to Verlet.
+	jobs->parallelFor(0, numPoints, params.grainSize, [this, &w, dt](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			if (!isPinned(i))
+			{
+				Vec3 pos = particles.pos(i);
+				Vec3 vel = particles.vel(i) + Vec3(w.dvX[i], w.dvY[i], w.dvZ[i]);
+				particles.setPrevPos(i, pos);
+				pos += vel * dt;
+				collidePoint(params, pos, vel);
+
+				particles.setPos(i, pos);
+				particles.setVel(i, vel);
+				particles.setForce(i, Vec3(Scalar(0)));
+			}
+		}
+	});
+}
+
+// Builds the Jacobian block of each spring and adds its part of the right
+// hand side and the diagonal to both points
+template <typename Scalar>
+void BasicClothSolver<Scalar>::jacobianBatch(int begin, int end, Scalar dt)
+{
+	BasicImplicitArrays<Scalar>& w = implicit;
+	for (int s = begin; s < end; s++)
+	{
+		uint32_t a = springs.point1[s];
+		uint32_t b = springs.point2[s];
+		Scalar dx = particles.posX[a] - particles.posX[b];
+		Scalar dy = particles.posY[a] - particles.posY[b];
+		Scalar dz = particles.posZ[a] - particles.posZ[b];
+		Scalar len = std::sqrt(dx * dx + dy * dy + dz * dz);
+		Scalar inv = 1.0f / len;
+		dx *= inv;
+		dy *= inv;
+		dz *= inv;
+
+		// -dF/dx = k (dd^T + c (I - dd^T)) with c = 1 - rest / len. c is
+		// clamped at zero, a compressed spring would make the matrix
+		// indefinite. -dF/dv = vK dd^T, the damping only acts along the spring.
+		Scalar c = 1.0f - springs.restLen[s] * inv;
+		if (c < 0.0f)
+			c = 0.0f;
+		Scalar k = springs.k[s];
+		Scalar along = dt * dt * k * (1.0f - c) + dt * springs.vK[s];
+		Scalar across = dt * dt * k * c;
+		w.jXX[s] = along * dx * dx + across;
+		w.jXY[s] = along * dx * dy;
+		w.jXZ[s] = along * dx * dz;
+		w.jYY[s] = along * dy * dy + across;
+		w.jYZ[s] = along * dy * dz;
+		w.jZZ[s] = along * dz * dz + across;
+
+		// h^2 dF/dx v for point a, point b gets the negation
+		Scalar vx = particles.velX[a] - particles.velX[b];
+		Scalar vy = particles.velY[a] - particles.velY[b];
+		Scalar vz = particles.velZ[a] - particles.velZ[b];
+		Scalar stretch = dt * dt * k * (1.0f - c) * (dx * vx + dy * vy + dz * vz);
+		Scalar shear = dt * dt * k * c;
+		Scalar fx = stretch * dx + shear * vx;
+		Scalar fy = stretch * dy + shear * vy;
+		Scalar fz = stretch * dz + shear * vz;
+		w.rX[a] -= fx;
+		w.rY[a] -= fy;
+		w.rZ[a] -= fz;
+		w.rX[b] += fx;
+		w.rY[b] += fy;
+		w.rZ[b] += fz;
+
+		w.invDiagX[a] += w.jXX[s];
+		w.invDiagY[a] += w.jYY[s];
+		w.invDiagZ[a] += w.jZZ[s];
+		w.invDiagX[b] += w.jXX[s];
+		w.invDiagY[b] += w.jYY[s];
+		w.invDiagZ[b] += w.jZZ[s];
+	}
+}
+
+// q += J (p_a - p_b) on point a and the negation on point b
+template <typename Scalar>
+void BasicClothSolver<Scalar>::systemBatch(int begin, int end)
+{
+	BasicImplicitArrays<Scalar>& w = implicit;
+	for (int s = begin; s < end; s++)
+	{
+		uint32_t a = springs.point1[s];
+		uint32_t b = springs.point2[s];
+		Scalar px = w.pX[a] - w.pX[b];
+		Scalar py = w.pY[a] - w.pY[b];
+		Scalar pz = w.pZ[a] - w.pZ[b];
+		Scalar qx = w.jXX[s] * px + w.jXY[s] * py + w.jXZ[s] * pz;
+		Scalar qy = w.jXY[s] * px + w.jYY[s] * py + w.jYZ[s] * pz;
+		Scalar qz = w.jXZ[s] * px + w.jYZ[s] * py + w.jZZ[s] * pz;
+		w.qX[a] += qx;
+		w.qY[a] += qy;
+		w.qZ[a] += qz;
+		w.qX[b] -= qx;
+		w.qY[b] -= qy;
+		w.qZ[b] -= qz;
+	}
+}
+
+template bool BasicClothSolver<float>::reserveImplicit();
+template void BasicClothSolver<float>::layoutImplicit(Arena& memory);
+template void BasicClothSolver<float>::implicitStep(float dt);
+template void BasicClothSolver<float>::blockSums(const std::function<void(int block, int begin, int end)>& fn, double& sum0, double& sum1);
+template void BasicClothSolver<float>::jacobianBatch(int begin, int end, float dt);
+template void BasicClothSolver<float>::systemBatch(int begin, int end);
+template bool BasicClothSolver<double>::reserveImplicit();
+template void BasicClothSolver<double>::layoutImplicit(Arena& memory);
+template void BasicClothSolver<double>::implicitStep(double dt);
+template void BasicClothSolver<double>::blockSums(const std::function<void(int block, int begin, int end)>& fn, double& sum0, double& sum1);
+template void BasicClothSolver<double>::jacobianBatch(int begin, int end, double dt);
+template void BasicClothSolver<double>::systemBatch(int begin, int end);
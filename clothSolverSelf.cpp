@@ -0,0 +1,280 @@
+// Self collision. After the points have moved, every point looks up the
+// triangles near it in a BVH over the cloth and is pushed out to selfThickness
+// from each one it is too close to, on the side of the triangle it was on
+// before the step, so a point that went through in one step comes back. Its
+// velocity towards the triangle is removed so it doesn't push in again.
+//
+// Every contact is found twice, by the point near the triangle and by the
+// triangle's corners near the cloth around the point, so each finding
+// resolves half of it. The half is split between the point and the
+// triangle's corners by how fast each came in, so a side lying still on the
+// floor leaves the other side to move, and the two shares add up to the
+// same push either way so the cloth keeps its momentum. Pinned and sleeping
+// corners don't move, the point takes the whole half against them. Pushed
+// points are kept out of the floor, the sphere and the props.
+//
+// Triangles with a corner at or next to the point are skipped, they are
+// always that close. The pushes are found for all points in parallel from
+// the same positions, the triangles' shares handed to their corners one
+// point at a time since neighbouring points share corners, and then applied.
+
+#include "clothPhysics.h"
+#include "clothSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Weights of a, b and c in the closest point to p on triangle abc (Ericson,
+// Real-Time Collision Detection 5.1.5)
+template <typename Scalar>
+static glm::tvec3<Scalar> closestOnTriangle(const glm::tvec3<Scalar>& p, const glm::tvec3<Scalar>& a,
+	const glm::tvec3<Scalar>& b, const glm::tvec3<Scalar>& c)
+{
+	typedef glm::tvec3<Scalar> Vec3;
+	Vec3 ab = b - a, ac = c - a, ap = p - a;
+	Scalar d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return Vec3(1, 0, 0);
+	Vec3 bp = p - b;
+	Scalar d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return Vec3(0, 1, 0);
+	Scalar vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		Scalar v = d1 / (d1 - d3);
+		return Vec3(1 - v, v, 0);
+	}
+	Vec3 cp = p - c;
+	Scalar d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return Vec3(0, 0, 1);
+	Scalar vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		Scalar w = d2 / (d2 - d6);
+		return Vec3(1 - w, 0, w);
+	}
+	Scalar va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		Scalar w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return Vec3(0, 1 - w, w);
+	}
+	Scalar denom = 1.0f / (va + vb + vc);
+	Scalar v = vb * denom, w = vc * denom;
+	return Vec3(1 - v - w, v, w);
+}
+
+template <typename Scalar>
+bool BasicClothSolver<Scalar>::reserveSelfCollision()
+{
+	if (selfReady)
+		return true;
+	Arena sizing;
+	layoutSelfCollision(sizing);
+	if (!selfArena.reserve(sizing.getUsed()))
+		return false;
+	layoutSelfCollision(selfArena);
+	bvh.build(clothIndices, numFaces, particles);
+	for (int f = 0; f < numFaces; f++)
+	{
+		self.faceRow[f] = (f / 2) / (columns - 1);
+		self.faceCol[f] = (f / 2) % (columns - 1);
+	}
+	selfReady = true;
+	return true;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::layoutSelfCollision(Arena& memory)
+{
+	bvh.layout(memory, numFaces);
+	self.pushX = memory.alloc<Scalar>(numPoints);
+	self.pushY = memory.alloc<Scalar>(numPoints);
+	self.pushZ = memory.alloc<Scalar>(numPoints);
+	int numSlots = numPoints * self.maxContacts;
+	self.numContacts = memory.alloc<uint8_t>(numPoints);
+	self.contactFace = memory.alloc<uint32_t>(numSlots);
+	self.reactX = memory.alloc<Scalar>(numSlots);
+	self.reactY = memory.alloc<Scalar>(numSlots);
+	self.reactZ = memory.alloc<Scalar>(numSlots);
+	self.weightB = memory.alloc<Scalar>(numSlots);
+	self.weightC = memory.alloc<Scalar>(numSlots);
+	self.faceRow = memory.alloc<int>(numFaces);
+	self.faceCol = memory.alloc<int>(numFaces);
+}
+
+// True if face f has a corner at point (row, col) or one of the eight
+// points around it. Faces come two per quad, the first with corners (0, 0),
+// (1, 0), (1, 1) of the quad and the second with (0, 0), (1, 1), (0, 1), see
+// the index setup in init().
+template <typename Scalar>
+bool BasicClothSolver<Scalar>::isNearFace(int row, int col, uint32_t f) const
+{
+	int rowOff = self.faceRow[f] - row;
+	int colOff = self.faceCol[f] - col;
+	// Quads more than one point away on either axis
+	if ((unsigned)(rowOff + 2) > 3u || (unsigned)(colOff + 2) > 3u)
+		return false;
+	// Diagonal quads where the only corner in reach is missing from one face
+	if (rowOff == -2 && colOff == 1)
+		return f % 2 == 0;
+	if (rowOff == 1 && colOff == -2)
+		return f % 2 == 1;
+	return true;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::selfCollide()
+{
+	Scalar thickness = params.selfThickness * shortestSpring;
+	bvh.refit(particles, *jobs, params.grainSize);
+	// Sleeping points stay put, the awake ones are pushed off them
+	forEachAwakePoint([this, thickness](int begin, int end) { pushBatch(begin, end, thickness); });
+
+	// Hand the triangles' shares to their corners. Sleeping points found no
+	// contacts this step, the ones they kept are from before they slept.
+	for (int i = 0; i < numPoints; i++)
+	{
+		if (isAsleep(i))
+			continue;
+		for (int k = 0; k < self.numContacts[i]; k++)
+		{
+			int slot = i * self.maxContacts + k;
+			const uint32_t* corners = &clothIndices[self.contactFace[slot] * 3];
+			Vec3 react(self.reactX[slot], self.reactY[slot], self.reactZ[slot]);
+			Scalar weights[3] = { 1 - self.weightB[slot] - self.weightC[slot], self.weightB[slot], self.weightC[slot] };
+			for (int j = 0; j < 3; j++)
+			{
+				self.pushX[corners[j]] += react.x * weights[j];
+				self.pushY[corners[j]] += react.y * weights[j];
+				self.pushZ[corners[j]] += react.z * weights[j];
+			}
+		}
+	}
+
+	forEachAwakePoint([this](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			Vec3 push(self.pushX[i], self.pushY[i], self.pushZ[i]);
+			if (isPinned(i) || push == Vec3(Scalar(0)))
+				continue;
+			Vec3 dir = glm::normalize(push);
+			Vec3 pos = particles.pos(i) + push;
+			// Keep the motion along the surface and away from it, drop the part going in
+			Vec3 vel = particles.vel(i);
+			Scalar in = glm::dot(vel, dir);
+			if (in < 0.0f)
+				vel -= in * dir;
+			Vec3 moved = particles.pos(i) - particles.prevPos(i);
+			Scalar movedIn = glm::dot(moved, dir);
+			if (movedIn < 0.0f)
+				moved -= movedIn * dir;
+			// Likewise for anything the push put the point into
+			Vec3 pushed = pos;
+			collidePoint(params, pos, vel);
+			if (pos != pushed)
+			{
+				Vec3 out = glm::normalize(pos - pushed);
+				Scalar movedOut = glm::dot(moved, out);
+				if (movedOut < 0.0f)
+					moved -= movedOut * out;
+			}
+			particles.setPos(i, pos);
+			particles.setVel(i, vel);
+			particles.setPrevPos(i, pos - moved);
+		}
+	});
+}
+
+// Average push out of every triangle each point is too close to, and the
+// triangles' side of the first few
+template <typename Scalar>
+void BasicClothSolver<Scalar>::pushBatch(int begin, int end, Scalar thickness)
+{
+	for (int i = begin; i < end; i++)
+	{
+		int row = i / columns, col = i % columns;
+		Vec3 p = particles.pos(i);
+		Vec3 prev = particles.prevPos(i);
+		Vec3 push(Scalar(0));
+		int hits = 0;
+		int contacts = 0;
+		auto held = [this](uint32_t j) { return isPinned(j) || isAsleep(j); };
+		bvh.query(p, thickness, [&](uint32_t f)
+		{
+			if (isNearFace(row, col, f))
+				return;
+			uint32_t a = clothIndices[f * 3], b = clothIndices[f * 3 + 1], c = clothIndices[f * 3 + 2];
+			Vec3 pa = particles.pos(a), pb = particles.pos(b), pc = particles.pos(c);
+			Vec3 weights = closestOnTriangle(p, pa, pb, pc);
+			Vec3 q = pa * weights.x + pb * weights.y + pc * weights.z;
+			if (glm::dot(p - q, p - q) >= thickness * thickness)
+				return;
+			Vec3 n = glm::cross(pb - pa, pc - pa);
+			Scalar area = glm::length(n);
+			if (area == 0.0f)
+				return;
+			n /= area;
+
+			// The side the point was on before this step
+			Scalar side = glm::dot(prev - particles.prevPos(a), n);
+			if (side == 0.0f)
+				side = glm::dot(p - q, n);
+			if (side < 0.0f)
+				n = -n;
+			Scalar height = glm::dot(p - q, n);
+			if (height < thickness)
+			{
+				Scalar depth = (thickness - height) * Scalar(0.5);
+				Scalar pointIn = std::max(-glm::dot(p - prev, n), Scalar(0));
+				Vec3 faceMoved = pa + pb + pc - particles.prevPos(a) - particles.prevPos(b) - particles.prevPos(c);
+				Scalar faceIn = std::max(glm::dot(faceMoved, n) / Scalar(3), Scalar(0));
+				Scalar share = pointIn + faceIn > 0.0f ? pointIn / (pointIn + faceIn) : Scalar(0.5);
+				if (held(a) && held(b) && held(c))
+					share = Scalar(1);
+				else if (isPinned(i))
+					share = Scalar(0);
+				push += n * (depth * share);
+				hits++;
+				if (share < 1.0f && contacts < self.maxContacts)
+				{
+					int slot = i * self.maxContacts + contacts++;
+					Vec3 react = -n * (depth * (1 - share));
+					self.contactFace[slot] = f;
+					self.reactX[slot] = react.x;
+					self.reactY[slot] = react.y;
+					self.reactZ[slot] = react.z;
+					self.weightB[slot] = weights.y;
+					self.weightC[slot] = weights.z;
+				}
+			}
+		});
+		if (hits > 0)
+			push /= (Scalar)hits;
+		for (int k = 0; k < contacts; k++)
+		{
+			int slot = i * self.maxContacts + k;
+			self.reactX[slot] /= (Scalar)hits;
+			self.reactY[slot] /= (Scalar)hits;
+			self.reactZ[slot] /= (Scalar)hits;
+		}
+		self.numContacts[i] = (uint8_t)contacts;
+		self.pushX[i] = push.x;
+		self.pushY[i] = push.y;
+		self.pushZ[i] = push.z;
+	}
+}
+
+template bool BasicClothSolver<float>::reserveSelfCollision();
+template void BasicClothSolver<float>::layoutSelfCollision(Arena& memory);
+template void BasicClothSolver<float>::selfCollide();
+template void BasicClothSolver<float>::pushBatch(int begin, int end, float thickness);
+template bool BasicClothSolver<float>::isNearFace(int row, int col, uint32_t f) const;
+template bool BasicClothSolver<double>::reserveSelfCollision();
+template void BasicClothSolver<double>::layoutSelfCollision(Arena& memory);
+template void BasicClothSolver<double>::selfCollide();
+template void BasicClothSolver<double>::pushBatch(int begin, int end, double thickness);
+template bool BasicClothSolver<double>::isNearFace(int row, int col, uint32_t f) const;
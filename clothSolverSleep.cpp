@@ -0,0 +1,460 @@
+// Sleeping. Once a cloth has settled over a prop it still integrates every
+// point and evaluates every spring each step, for points that don't move.
+// The cloth is split into square tiles of params.sleepTile points, and a tile
+// whose points all moved less than sleepSpeed * dt in each of the last
+// sleepSteps steps falls asleep: its velocities are zeroed and it drops out
+// of the spring, face and point passes, XPBD's constraints and self
+// collision. It wakes when
+//   - an awake tile next to it moves faster than four times sleepSpeed, or
+//   - the sphere or a prop moves over its box, or is added or removed there.
+// The floor never moves, so it can't wake anything. Gravity, the air and the
+// other parameters aren't watched, whoever changes them calls wake().
+//
+// To the awake points next to it a sleeping point holds still like a pin.
+// Within each color the springs are sorted by the tile of their first point,
+// those inside the tile first and then those reaching into a neighbour, so
+// the springs to run are a few ranges per color: all of an awake tile's, and
+// the reaching ones of a sleeping tile next to an awake one. A tile's points
+// are one range per row and its faces two per row of quads. The lists are
+// only rebuilt when a tile falls asleep or wakes.
+//
+// While no tile sleeps every pass runs over whole ranges as it would without
+// sleeping. The implicit integrator solves the whole cloth at once and never
+// sleeps. Which tiles sleep only depends on the cloth's state, not on the
+// threads, so replays stay exact.
+
+#include "clothSolver.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static bool sameCollider(const Collider& a, const Collider& b)
+{
+	return a.type == b.type && a.a == b.a && a.b == b.b && a.radius == b.radius;
+}
+
+template <typename Scalar>
+bool BasicClothSolver<Scalar>::reserveSleep()
+{
+	if (sleepReady)
+		return true;
+	tileSize = std::max(params.sleepTile, 2);
+	tileRows = (rows + tileSize - 1) / tileSize;
+	tileColumns = (columns + tileSize - 1) / tileSize;
+	numTiles = tileRows * tileColumns;
+	Arena sizing;
+	layoutSleep(sizing);
+	if (!sleepArena.reserve(sizing.getUsed()))
+		return false;
+	layoutSleep(sleepArena);
+
+	for (int t = 0; t < numTiles; t++)
+	{
+		sleepState.calmSteps[t] = 0;
+		sleepState.tileAsleep[t] = 0;
+		sleepState.tileMoving[t] = 0;
+		sleepState.tileDisturbed[t] = 0;
+	}
+	for (int i = 0; i < numPoints; i++)
+		sleepState.pointAsleep[i] = 0;
+	numAsleep = 0;
+	sortSpringsByTile();
+	buildAwakeLists();
+
+	lastSpherePos = params.spherePos;
+	lastSphereR = params.sphereR;
+	lastColliders.clear();
+	if (params.colliders)
+		for (int c = 0; c < params.colliders->size(); c++)
+			lastColliders.push_back(params.colliders->get(c));
+	sleepReady = true;
+	return true;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::layoutSleep(Arena& memory)
+{
+	sleepState.calmSteps = memory.alloc<int32_t>(numTiles);
+	sleepState.tileAsleep = memory.alloc<uint8_t>(numTiles);
+	sleepState.tileMoving = memory.alloc<uint8_t>(numTiles);
+	sleepState.tileDisturbed = memory.alloc<uint8_t>(numTiles);
+	sleepState.loX = memory.alloc<float>(numTiles);
+	sleepState.loY = memory.alloc<float>(numTiles);
+	sleepState.loZ = memory.alloc<float>(numTiles);
+	sleepState.hiX = memory.alloc<float>(numTiles);
+	sleepState.hiY = memory.alloc<float>(numTiles);
+	sleepState.hiZ = memory.alloc<float>(numTiles);
+	sleepState.pointAsleep = memory.alloc<uint8_t>(numPoints);
+
+	sleepState.runStart = memory.alloc<uint32_t>(numSpringColors * numTiles * 2 + 1);
+	sleepState.awakeTiles = memory.alloc<uint32_t>(numTiles);
+	sleepState.borderTiles = memory.alloc<uint32_t>(numTiles);
+	// A tile adds at most one range to each color
+	sleepState.springRuns = memory.alloc<uint32_t>(numSpringColors * numTiles * 2);
+	sleepState.colorRunStart = memory.alloc<uint32_t>(numSpringColors + 1);
+}
+
+// Reorders the springs within each color, which changes nothing about what
+// they add up to: each point has at most one spring of a color.
+template <typename Scalar>
+void BasicClothSolver<Scalar>::sortSpringsByTile()
+{
+	int keys = numTiles * 2;
+	std::vector<int> key(numSprings);
+	for (int s = 0; s < numSprings; s++)
+	{
+		int t = tileOf(springs.point1[s]);
+		key[s] = t * 2 + (tileOf(springs.point2[s]) != t ? 1 : 0);
+	}
+
+	std::vector<int> order(numSprings);
+	std::vector<uint32_t> next;
+	for (int c = 0; c < numSpringColors; c++)
+	{
+		uint32_t* start = sleepState.runStart + c * keys;
+		std::fill(start, start + keys, 0u);
+		for (int s = springColorStart[c]; s < springColorStart[c + 1]; s++)
+			start[key[s]]++;
+		uint32_t at = springColorStart[c];
+		for (int k = 0; k < keys; k++)
+		{
+			uint32_t count = start[k];
+			start[k] = at;
+			at += count;
+		}
+		next.assign(start, start + keys);
+		for (int s = springColorStart[c]; s < springColorStart[c + 1]; s++)
+			order[next[key[s]]++] = s;
+	}
+	sleepState.runStart[numSpringColors * keys] = numSprings;
+
+	applyOrder(springs.point1, order);
+	applyOrder(springs.point2, order);
+	applyOrder(springs.restLen, order);
+	applyOrder(springs.k, order);
+	applyOrder(springs.vK, order);
+}
+
+template <typename Scalar>
+template <typename Test>
+bool BasicClothSolver<Scalar>::anyNeighbour(int t, Test test) const
+{
+	int row = t / tileColumns, col = t % tileColumns;
+	for (int r = std::max(row - 1, 0); r <= std::min(row + 1, tileRows - 1); r++)
+		for (int c = std::max(col - 1, 0); c <= std::min(col + 1, tileColumns - 1); c++)
+			if ((r != row || c != col) && test(r * tileColumns + c))
+				return true;
+	return false;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::buildAwakeLists()
+{
+	const uint8_t* asleep = sleepState.tileAsleep;
+	numAwakeTiles = 0;
+	numBorderTiles = 0;
+	for (int t = 0; t < numTiles; t++)
+	{
+		if (!asleep[t])
+			sleepState.awakeTiles[numAwakeTiles++] = t;
+		else if (anyNeighbour(t, [asleep](int n) { return !asleep[n]; }))
+			sleepState.borderTiles[numBorderTiles++] = t;
+	}
+
+	// Neighbouring ranges are joined up to grainSize springs, each range is
+	// one task
+	int keys = numTiles * 2;
+	uint32_t* runs = sleepState.springRuns;
+	int numRuns = 0;
+	for (int c = 0; c < numSpringColors; c++)
+	{
+		sleepState.colorRunStart[c] = numRuns;
+		int border = 0;
+		for (int t = 0; t < numTiles; t++)
+		{
+			const uint32_t* start = sleepState.runStart + c * keys + t * 2;
+			uint32_t begin;
+			if (!asleep[t])
+				begin = start[0];
+			else if (border < numBorderTiles && sleepState.borderTiles[border] == (uint32_t)t)
+			{
+				begin = start[1];
+				border++;
+			}
+			else
+				continue;
+			uint32_t end = start[2];
+			if (begin == end)
+				continue;
+			if (numRuns > (int)sleepState.colorRunStart[c] && runs[numRuns * 2 - 1] == begin &&
+				end - runs[numRuns * 2 - 2] <= (uint32_t)params.grainSize)
+				runs[numRuns * 2 - 1] = end;
+			else
+			{
+				runs[numRuns * 2] = begin;
+				runs[numRuns * 2 + 1] = end;
+				numRuns++;
+			}
+		}
+	}
+	sleepState.colorRunStart[numSpringColors] = numRuns;
+
+	uint32_t numRunSprings = 0;
+	for (int r = 0; r < numRuns; r++)
+		numRunSprings += runs[r * 2 + 1] - runs[r * 2];
+	runGrain = numRunSprings > 0 ? std::max(1, (int)((int64_t)params.grainSize * numRuns / numRunSprings)) : 1;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::forEachAwakePoint(const RangeFunction& fn)
+{
+	if (numAsleep == 0)
+	{
+		jobs->parallelFor(0, numPoints, params.grainSize, fn);
+		return;
+	}
+	int grain = std::max(1, params.grainSize / (tileSize * tileSize));
+	jobs->parallelFor(0, numAwakeTiles, grain, [this, &fn](int begin, int end)
+	{
+		for (int k = begin; k < end; k++)
+		{
+			int t = sleepState.awakeTiles[k];
+			int r0 = t / tileColumns * tileSize, c0 = t % tileColumns * tileSize;
+			int r1 = std::min(r0 + tileSize, rows), c1 = std::min(c0 + tileSize, columns);
+			for (int r = r0; r < r1; r++)
+				fn(r * columns + c0, r * columns + c1);
+		}
+	});
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::forEachAwakeFace(const RangeFunction& fn)
+{
+	if (numAsleep == 0)
+	{
+		jobs->parallelFor(0, numFaces, params.grainSize, fn);
+		return;
+	}
+	// Two faces per quad, quad (r, c) has the corners (r, c) to (r + 1, c + 1)
+	// and faces (r * (columns - 1) + c) * 2 and the one after
+	int quadColumns = columns - 1;
+	auto quads = [&fn, quadColumns](int r0, int r1, int c0, int c1)
+	{
+		for (int r = r0; r < r1; r++)
+			fn((r * quadColumns + c0) * 2, (r * quadColumns + c1) * 2);
+	};
+	int grain = std::max(1, params.grainSize / (tileSize * tileSize));
+	jobs->parallelFor(0, numAwakeTiles + numBorderTiles, grain, [this, &quads, quadColumns](int begin, int end)
+	{
+		const uint8_t* asleep = sleepState.tileAsleep;
+		for (int k = begin; k < end; k++)
+		{
+			bool awake = k < numAwakeTiles;
+			int t = awake ? sleepState.awakeTiles[k] : sleepState.borderTiles[k - numAwakeTiles];
+			int row = t / tileColumns, col = t % tileColumns;
+			int r0 = row * tileSize, c0 = col * tileSize;
+			int r1 = std::min(r0 + tileSize, rows - 1), c1 = std::min(c0 + tileSize, quadColumns);
+			if (r0 >= r1 || c0 >= c1)
+				continue;
+			if (awake)
+			{
+				quads(r0, r1, c0, c1);
+				continue;
+			}
+			// A sleeping tile's last row and column of quads have corners in
+			// the tiles below and to the right
+			bool belowRight = row + 1 < tileRows && col + 1 < tileColumns && !asleep[t + tileColumns + 1];
+			if (belowRight || (row + 1 < tileRows && !asleep[t + tileColumns]))
+				quads(r1 - 1, r1, c0, c1);
+			if (belowRight || (col + 1 < tileColumns && !asleep[t + 1]))
+				quads(r0, r1, c1 - 1, c1);
+		}
+	});
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::updateSleep(Scalar dt)
+{
+	// Points slower than sleepSpeed are calm, a tile only wakes its neighbours
+	// at four times that. A tile falling asleep jolts the awake points next to
+	// it, most of all under XPBD, and that alone mustn't wake it again.
+	Scalar limit = Scalar(params.sleepSpeed) * dt;
+	Scalar limit2 = limit * limit;
+	Scalar wakeLimit2 = limit2 * Scalar(16);
+	int grain = std::max(1, params.grainSize / (tileSize * tileSize));
+	jobs->parallelFor(0, numAwakeTiles, grain, [this, limit2, wakeLimit2](int begin, int end)
+	{
+		for (int k = begin; k < end; k++)
+		{
+			int t = sleepState.awakeTiles[k];
+			int r0 = t / tileColumns * tileSize, c0 = t % tileColumns * tileSize;
+			int r1 = std::min(r0 + tileSize, rows), c1 = std::min(c0 + tileSize, columns);
+			Scalar fastest = Scalar(0);
+			for (int r = r0; r < r1; r++)
+			{
+				for (int i = r * columns + c0; i < r * columns + c1; i++)
+				{
+					Vec3 moved = particles.pos(i) - particles.prevPos(i);
+					fastest = std::max(fastest, glm::dot(moved, moved));
+				}
+			}
+			// A tile that blew up is never calm
+			sleepState.tileMoving[t] = !(fastest <= wakeLimit2);
+			sleepState.calmSteps[t] = !(fastest <= limit2) ? 0 : sleepState.calmSteps[t] + 1;
+		}
+	});
+	watchColliders();
+
+	// One tile after another, each decision looks at the neighbours'
+	const uint8_t* moving = sleepState.tileMoving;
+	auto isMoving = [moving](int n) { return moving[n] != 0; };
+	bool changed = false;
+	for (int t = 0; t < numTiles; t++)
+	{
+		if (sleepState.tileAsleep[t])
+		{
+			if (sleepState.tileDisturbed[t] || anyNeighbour(t, isMoving))
+			{
+				wakeTile(t);
+				changed = true;
+			}
+		}
+		else if (sleepState.calmSteps[t] >= params.sleepSteps && !anyNeighbour(t, isMoving))
+		{
+			putTileToSleep(t);
+			changed = true;
+		}
+	}
+	if (changed)
+		buildAwakeLists();
+}
+
+// Marks the sleeping tiles the sphere or a prop moved over since the last step
+template <typename Scalar>
+void BasicClothSolver<Scalar>::watchColliders()
+{
+	if (params.spherePos != lastSpherePos || params.sphereR != lastSphereR)
+	{
+		// Where it was and where it is, cloth lying on it falls once it's gone
+		glm::vec3 reach(lastSphereR + colliderBuffer);
+		disturbTiles(lastSpherePos - reach, lastSpherePos + reach);
+		reach = glm::vec3(params.sphereR + colliderBuffer);
+		disturbTiles(params.spherePos - reach, params.spherePos + reach);
+		lastSpherePos = params.spherePos;
+		lastSphereR = params.sphereR;
+	}
+
+	const ColliderSet* colliders = params.colliders;
+	int numColliders = colliders ? colliders->size() : 0;
+	int numLast = (int)lastColliders.size();
+	for (int c = 0; c < std::max(numColliders, numLast); c++)
+	{
+		if (c < numColliders && c < numLast && sameCollider(colliders->get(c), lastColliders[c]))
+			continue;
+		glm::vec3 lo, hi;
+		if (c < numLast)
+		{
+			ColliderSet::bounds(lastColliders[c], lo, hi);
+			disturbTiles(lo, hi);
+		}
+		if (c < numColliders)
+		{
+			ColliderSet::bounds(colliders->get(c), lo, hi);
+			disturbTiles(lo, hi);
+			if (c < numLast)
+				lastColliders[c] = colliders->get(c);
+			else
+				lastColliders.push_back(colliders->get(c));
+		}
+	}
+	lastColliders.resize(numColliders);
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::disturbTiles(const glm::vec3& lo, const glm::vec3& hi)
+{
+	if (numAsleep == 0)
+		return;
+	for (int t = 0; t < numTiles; t++)
+	{
+		if (sleepState.tileAsleep[t] &&
+			lo.x <= sleepState.hiX[t] && hi.x >= sleepState.loX[t] &&
+			lo.y <= sleepState.hiY[t] && hi.y >= sleepState.loY[t] &&
+			lo.z <= sleepState.hiZ[t] && hi.z >= sleepState.loZ[t])
+			sleepState.tileDisturbed[t] = 1;
+	}
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::putTileToSleep(int t)
+{
+	int r0 = t / tileColumns * tileSize, c0 = t % tileColumns * tileSize;
+	int r1 = std::min(r0 + tileSize, rows), c1 = std::min(c0 + tileSize, columns);
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (int r = r0; r < r1; r++)
+	{
+		for (int i = r * columns + c0; i < r * columns + c1; i++)
+		{
+			// Wakes at rest, Verlet's velocity is the last move
+			Vec3 pos = particles.pos(i);
+			particles.setPrevPos(i, pos);
+			particles.setVel(i, Vec3(Scalar(0)));
+			particles.setForce(i, Vec3(Scalar(0)));
+			sleepState.pointAsleep[i] = 1;
+			lo = glm::min(lo, glm::vec3(pos));
+			hi = glm::max(hi, glm::vec3(pos));
+		}
+	}
+	sleepState.loX[t] = lo.x;
+	sleepState.loY[t] = lo.y;
+	sleepState.loZ[t] = lo.z;
+	sleepState.hiX[t] = hi.x;
+	sleepState.hiY[t] = hi.y;
+	sleepState.hiZ[t] = hi.z;
+	sleepState.tileAsleep[t] = 1;
+	numAsleep++;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::wakeTile(int t)
+{
+	int r0 = t / tileColumns * tileSize, c0 = t % tileColumns * tileSize;
+	int r1 = std::min(r0 + tileSize, rows), c1 = std::min(c0 + tileSize, columns);
+	for (int r = r0; r < r1; r++)
+	{
+		for (int i = r * columns + c0; i < r * columns + c1; i++)
+		{
+			// Springs reaching in from awake tiles kept adding to it
+			particles.setForce(i, Vec3(Scalar(0)));
+			sleepState.pointAsleep[i] = 0;
+		}
+	}
+	sleepState.tileAsleep[t] = 0;
+	sleepState.tileMoving[t] = 0;
+	sleepState.tileDisturbed[t] = 0;
+	sleepState.calmSteps[t] = 0;
+	numAsleep--;
+}
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::wake()
+{
+	if (numAsleep == 0)
+		return;
+	for (int t = 0; t < numTiles; t++)
+		if (sleepState.tileAsleep[t])
+			wakeTile(t);
+	buildAwakeLists();
+	updateView();
+}
+
+template bool BasicClothSolver<float>::reserveSleep();
+template void BasicClothSolver<float>::forEachAwakePoint(const RangeFunction& fn);
+template void BasicClothSolver<float>::forEachAwakeFace(const RangeFunction& fn);
+template void BasicClothSolver<float>::updateSleep(float dt);
+template void BasicClothSolver<float>::wake();
+template bool BasicClothSolver<double>::reserveSleep();
+template void BasicClothSolver<double>::forEachAwakePoint(const RangeFunction& fn);
+template void BasicClothSolver<double>::forEachAwakeFace(const RangeFunction& fn);
+template void BasicClothSolver<double>::updateSleep(double dt);
+template void BasicClothSolver<double>::wake();
@@ -0,0 +1,107 @@
+// Extended position based dynamics (Macklin, Mueller and Chentanez, XPBD:
+// Position-Based Simulation of Compliant Constrained Dynamics). Every spring
+// becomes a distance constraint whose compliance is 1 / k, so the cloth is
+// as stretchy as with the force based integrators but stays stable at frame
+// sized steps: one 16 ms step with a few iterations replaces sixteen 1 ms
+// force steps.
+//
+// A step predicts positions from the forces (gravity and drag), projects the
+// constraints xpbdIterations times one spring color at a time, then derives
+// the velocities from how far the points moved. Spring damping vK becomes
+// the XPBD constraint damping. Collisions are resolved at the end of the
+// step, the same way as the other integrators.
+
+#include "clothSolver.h"
+
+#include "clothPhysics.h"
+
+#include <cmath>
+
+template <typename Scalar>
+void BasicClothSolver<Scalar>::xpbdStep(Scalar dt)
+{
+	Scalar mass = clothMass;
+
+	// Predict where the forces alone would take each point
+	forEachAwakePoint([this, mass, dt](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			Vec3 pos = particles.pos(i);
+			particles.setPrevPos(i, pos);
+			if (isPinned(i))
+				continue;
+			Vec3 vel = particles.vel(i) + (particles.force(i) / mass + Vec3(params.grav)) * dt;
+			particles.setPos(i, pos + vel * dt);
+			particles.setVel(i, vel);
+			particles.setForce(i, Vec3(Scalar(0)));
+		}
+	});
+	jobs->parallelFor(0, numSprings, params.grainSize, [this](int begin, int end)
+	{
+		for (int s = begin; s < end; s++)
+			springs.lambda[s] = 0.0f;
+	});
+
+	for (int it = 0; it < params.xpbdIterations; it++)
+		forEachSpringColor([this, dt](int begin, int end) { constraintBatch(begin, end, dt); });
+
+	forEachAwakePoint([this, dt](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			if (!isPinned(i))
+			{
+				Vec3 pos = particles.pos(i);
+				Vec3 vel = (pos - particles.prevPos(i)) / dt;
+				collidePoint(params, pos, vel);
+
+				particles.setPos(i, pos);
+				particles.setVel(i, vel);
+			}
+		}
+	});
+}
+
+// One projection of each spring's distance constraint. Springs of a color
+// share no points, so a color can be split up freely.
+template <typename Scalar>
+void BasicClothSolver<Scalar>::constraintBatch(int begin, int end, Scalar dt)
+{
+	Scalar invMass = 1.0f / clothMass;
+	for (int s = begin; s < end; s++)
+	{
+		uint32_t a = springs.point1[s];
+		uint32_t b = springs.point2[s];
+		// Sleeping points hold still like pins
+		Scalar wA = isPinned(a) || isAsleep(a) ? 0.0f : invMass;
+		Scalar wB = isPinned(b) || isAsleep(b) ? 0.0f : invMass;
+		Scalar k = springs.k[s];
+		if (wA + wB == 0.0f || k <= 0.0f)
+			continue;
+
+		Vec3 pA = particles.pos(a);
+		Vec3 pB = particles.pos(b);
+		Vec3 d = pA - pB;
+		Scalar len = glm::length(d);
+		if (len == 0.0f)
+			continue;
+		Vec3 n = d / len;
+
+		// Compliance scaled by the step, and damping along the spring
+		Scalar alpha = 1.0f / (k * dt * dt);
+		Scalar gamma = springs.vK[s] / (k * dt);
+		Scalar c = len - springs.restLen[s];
+		Scalar moved = glm::dot(n, (pA - particles.prevPos(a)) - (pB - particles.prevPos(b)));
+		Scalar dLambda = (-c - alpha * springs.lambda[s] - gamma * moved) / ((1.0f + gamma) * (wA + wB) + alpha);
+		springs.lambda[s] += dLambda;
+
+		particles.setPos(a, pA + wA * dLambda * n);
+		particles.setPos(b, pB - wB * dLambda * n);
+	}
+}
+
+template void BasicClothSolver<float>::xpbdStep(float dt);
+template void BasicClothSolver<float>::constraintBatch(int begin, int end, float dt);
+template void BasicClothSolver<double>::xpbdStep(double dt);
+template void BasicClothSolver<double>::constraintBatch(int begin, int end, double dt);
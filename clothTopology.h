@@ -0,0 +1,139 @@
+#ifndef CLOTH_TOPOLOGY_H
+#define CLOTH_TOPOLOGY_H
+
+// Which points of a rows x columns grid are joined by springs. Every spring
+// joins a point to the one di rows down and dj columns across, for one of a
+// few fixed directions:
+//   structural - neighbours in a row or column, keep the cloth from stretching
+//   shear      - diagonal neighbours, keep the squares from collapsing
+//   bend       - points two apart in a row or column, resist folding
+// Shear and bend springs can be turned off and each type has its own
+// stiffness and damping in ClothParams.
+
+#include "clothData.h"
+#include "clothParams.h"
+#include "coloring.h"
+
+#include <cstdlib>
+#include <vector>
+
+enum SpringType
+{
+	SPRING_STRUCTURAL,
+	SPRING_SHEAR,
+	SPRING_BEND
+};
+
+struct SpringDirection
+{
+	int di, dj;
+	SpringType type;
+};
+
+const int numSpringDirections = 6;
+const SpringDirection springDirections[numSpringDirections] =
+{
+	{ 0, 1, SPRING_STRUCTURAL },
+	{ 1, 0, SPRING_STRUCTURAL },
+	{ 1, 1, SPRING_SHEAR },
+	{ 1, -1, SPRING_SHEAR },
+	{ 0, 2, SPRING_BEND },
+	{ 2, 0, SPRING_BEND }
+};
+
+inline bool springTypeUsed(const ClothParams& params, SpringType type)
+{
+	return type == SPRING_STRUCTURAL || (type == SPRING_SHEAR ? params.shearSprings : params.bendSprings);
+}
+
+inline float springStiffness(const ClothParams& params, SpringType type)
+{
+	return type == SPRING_STRUCTURAL ? params.clothK : type == SPRING_SHEAR ? params.crossClothK : params.bendK;
+}
+
+inline float springDamping(const ClothParams& params, SpringType type)
+{
+	return type == SPRING_STRUCTURAL ? params.dampK : type == SPRING_SHEAR ? params.crossDampK : params.bendDampK;
+}
+
+// True if (i, j) is a point with a spring in direction d, i.e. both ends are on the grid
+inline bool hasSpring(const SpringDirection& d, int rows, int columns, int i, int j)
+{
+	return i >= 0 && j >= 0 && j < columns && i + d.di < rows && j + d.dj >= 0 && j + d.dj < columns;
+}
+
+// Where point (i, j) of a rows x columns cloth starts: laid out flat from
+// params.origin, rows along x and columns along -z
+inline glm::vec3 flatPosition(const ClothParams& params, int rows, int columns, int i, int j)
+{
+	float scale = params.scale;
+	return params.origin + glm::vec3(scale * 1.92f * ((float)i / rows), 0.0f, -scale * 1.220f * ((float)j / columns));
+}
+
+// Number of springs of a rows x columns cloth
+inline int countSprings(const ClothParams& params, int rows, int columns)
+{
+	int count = 0;
+	for (const SpringDirection& d : springDirections)
+	{
+		if (springTypeUsed(params, d.type) && rows > d.di && columns > std::abs(d.dj))
+			count += (rows - d.di) * (columns - std::abs(d.dj));
+	}
+	return count;
+}
+
+// Fills in the ends, stiffness and damping of countSprings springs. They
+// are sorted by their first point, and a point's springs are next to each
+// other, so springs that are close in memory touch points that are close in
+// memory. Rest lengths depend on where the points are and are left to the
+// caller.
+template <typename Scalar>
+inline void buildSprings(const ClothParams& params, int rows, int columns, BasicSpringArrays<Scalar>& springs)
+{
+	int s = 0;
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < columns; j++)
+		{
+			for (const SpringDirection& d : springDirections)
+			{
+				if (!springTypeUsed(params, d.type) || !hasSpring(d, rows, columns, i, j))
+					continue;
+				springs.point1[s] = i * columns + j;
+				springs.point2[s] = (i + d.di) * columns + j + d.dj;
+				springs.k[s] = springStiffness(params, d.type);
+				springs.vK[s] = springDamping(params, d.type);
+				s++;
+			}
+		}
+	}
+}
+
+// Sorts numSprings springs into batches that share no points, batch c
+// being springs colorStart[c] .. colorStart[c + 1] - 1. Returns false if
+// that would take more than maxColors colors; the springs are then left as
+// they are, in one batch.
+template <typename Scalar>
+inline bool colorSprings(BasicSpringArrays<Scalar>& springs, int numSprings, int numPoints, int& numColors, int* colorStart)
+{
+	std::vector<int> colorOf(numSprings);
+	numColors = colorElements(numSprings, 2, numPoints,
+		[&springs](int e, int k) { return k == 0 ? springs.point1[e] : springs.point2[e]; }, colorOf.data());
+	if (numColors <= 0)
+	{
+		numColors = 1;
+		colorStart[0] = 0;
+		colorStart[1] = numSprings;
+		return false;
+	}
+
+	std::vector<int> order;
+	sortByColor(numSprings, colorOf.data(), numColors, colorStart, order);
+	applyOrder(springs.point1, order);
+	applyOrder(springs.point2, order);
+	applyOrder(springs.k, order);
+	applyOrder(springs.vK, order);
+	return true;
+}
+
+#endif
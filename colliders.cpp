@@ -0,0 +1,169 @@
+#include "colliders.h"
+
+#include <algorithm>
+
+int ColliderSet::addSphere(const glm::vec3& centre, float radius)
+{
+	colliders.push_back({ COLLIDER_SPHERE, centre, centre, radius });
+	return size() - 1;
+}
+
+int ColliderSet::addCapsule(const glm::vec3& a, const glm::vec3& b, float radius)
+{
+	colliders.push_back({ COLLIDER_CAPSULE, a, b, radius });
+	return size() - 1;
+}
+
+int ColliderSet::addBox(const glm::vec3& centre, const glm::vec3& halfSize)
+{
+	colliders.push_back({ COLLIDER_BOX, centre, halfSize, 0.0f });
+	return size() - 1;
+}
+
+void ColliderSet::clear()
+{
+	colliders.clear();
+	build();
+}
+
+void ColliderSet::bounds(const Collider& c, glm::vec3& lo, glm::vec3& hi)
+{
+	switch (c.type)
+	{
+	case COLLIDER_SPHERE:
+		lo = c.a - glm::vec3(c.radius);
+		hi = c.a + glm::vec3(c.radius);
+		break;
+	case COLLIDER_CAPSULE:
+		lo = glm::min(c.a, c.b) - glm::vec3(c.radius);
+		hi = glm::max(c.a, c.b) + glm::vec3(c.radius);
+		break;
+	case COLLIDER_BOX:
+		lo = c.a - c.b;
+		hi = c.a + c.b;
+		break;
+	}
+	lo -= glm::vec3(colliderBuffer);
+	hi += glm::vec3(colliderBuffer);
+}
+
+// Calls fn with the bucket of every cell the collider overlaps. A collider
+// can land in one bucket twice, testing it twice does no harm.
+template <typename Fn>
+void ColliderSet::forEachBucket(const Collider& c, Fn fn) const
+{
+	glm::vec3 lo, hi;
+	bounds(c, lo, hi);
+	for (uint32_t x = cellOf(lo, 0); x != cellOf(hi, 0) + 1; x++)
+		for (uint32_t y = cellOf(lo, 1); y != cellOf(hi, 1) + 1; y++)
+			for (uint32_t z = cellOf(lo, 2); z != cellOf(hi, 2) + 1; z++)
+				fn(bucket(x, y, z));
+}
+
+void ColliderSet::build(float cellSize)
+{
+	large.clear();
+	bucketColliders.clear();
+	if (colliders.empty())
+	{
+		numBuckets = 1;
+		bucketStart.assign(2, 0);
+		return;
+	}
+
+	if (cellSize <= 0.0f)
+	{
+		for (const Collider& c : colliders)
+		{
+			glm::vec3 lo, hi;
+			bounds(c, lo, hi);
+			glm::vec3 size = hi - lo;
+			cellSize += std::max(size.x, std::max(size.y, size.z));
+		}
+		cellSize /= colliders.size();
+	}
+	invCellSize = 1.0f / std::max(cellSize, 1e-3f);
+
+	// Cells each collider covers, the big ones go on the large list
+	size_t cells = 0;
+	colliderCells.assign(colliders.size(), 0);
+	for (size_t i = 0; i < colliders.size(); i++)
+	{
+		glm::vec3 lo, hi;
+		bounds(colliders[i], lo, hi);
+		double covered = 1.0;
+		for (int axis = 0; axis < 3; axis++)
+			covered *= std::floor(hi[axis] * invCellSize) - std::floor(lo[axis] * invCellSize) + 1.0;
+		if (covered > maxCellsPerCollider)
+			large.push_back((uint32_t)i);
+		else
+		{
+			colliderCells[i] = (uint32_t)covered;
+			cells += (size_t)covered;
+		}
+	}
+
+	// About two buckets per cell keeps unrelated cells mostly apart
+	numBuckets = 1;
+	while (numBuckets < cells * 2)
+		numBuckets *= 2;
+
+	// Count, prefix sum, then fill, so each bucket's colliders are contiguous
+	bucketStart.assign(numBuckets + 1, 0);
+	for (size_t i = 0; i < colliders.size(); i++)
+		if (colliderCells[i] > 0)
+			forEachBucket(colliders[i], [this](uint32_t b) { bucketStart[b + 1]++; });
+	for (uint32_t b = 0; b < numBuckets; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	bucketColliders.resize(bucketStart[numBuckets]);
+	bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+	for (size_t i = 0; i < colliders.size(); i++)
+		if (colliderCells[i] > 0)
+			forEachBucket(colliders[i], [this, i](uint32_t b) { bucketColliders[bucketFill[b]++] = (uint32_t)i; });
+}
+
+void ColliderSet::collide(glm::vec3& pos, glm::vec3& vel) const
+{
+	for (uint32_t i : large)
+		collideWith(colliders[i], pos, vel);
+	uint32_t b = bucket(cellOf(pos, 0), cellOf(pos, 1), cellOf(pos, 2));
+	for (uint32_t k = bucketStart[b]; k < bucketStart[b + 1]; k++)
+		collideWith(colliders[bucketColliders[k]], pos, vel);
+}
+
+void ColliderSet::collideWith(const Collider& c, glm::vec3& pos, glm::vec3& vel) const
+{
+	if (c.type == COLLIDER_BOX)
+	{
+		// Out through the nearest side
+		glm::vec3 off = pos - c.a;
+		glm::vec3 depth = c.b + glm::vec3(colliderBuffer) - glm::abs(off);
+		if (depth.x <= 0.0f || depth.y <= 0.0f || depth.z <= 0.0f)
+			return;
+		int axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2) : (depth.y < depth.z ? 1 : 2);
+		glm::vec3 n(0.0f);
+		n[axis] = off[axis] < 0.0f ? -1.0f : 1.0f;
+		pos[axis] += n[axis] * depth[axis];
+		vel = glm::reflect(vel, n);
+		return;
+	}
+
+	// Spheres and capsules push out from the nearest point of their core
+	glm::vec3 core = c.a;
+	if (c.type == COLLIDER_CAPSULE)
+	{
+		glm::vec3 axis = c.b - c.a;
+		float lengthSq = glm::dot(axis, axis);
+		float t = lengthSq > 0.0f ? glm::clamp(glm::dot(pos - c.a, axis) / lengthSq, 0.0f, 1.0f) : 0.0f;
+		core = c.a + t * axis;
+	}
+	glm::vec3 off = pos - core;
+	float reach = c.radius + colliderBuffer;
+	float dist = glm::length(off);
+	if (dist >= reach)
+		return;
+	glm::vec3 n = dist > 0.0f ? off / dist : glm::vec3(0.0f, 1.0f, 0.0f);
+	pos = core + n * reach;
+	vel = glm::reflect(vel, n);
+}
@@ -0,0 +1,77 @@
+#ifndef COLLIDERS_H
+#define COLLIDERS_H
+
+// Props the cloth drapes over: spheres, capsules and axis aligned boxes.
+// build() hashes every collider into the cells of a uniform grid it
+// overlaps, so a point only tests the colliders in its own cell rather than
+// all of them. Cells are hashed into a fixed size table, two cells sharing a
+// bucket only costs a few extra tests.
+//
+// Rebuild whenever a collider moves, before stepping. collide() only reads
+// the set, so any number of threads and cloths can share one.
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Points are kept this far out of every collider
+const float colliderBuffer = 0.03f;
+
+enum ColliderType
+{
+	COLLIDER_SPHERE,  // a is the centre
+	COLLIDER_CAPSULE, // sphere swept from a to b
+	COLLIDER_BOX      // a is the centre, b the half size on each axis
+};
+
+struct Collider
+{
+	ColliderType type;
+	glm::vec3 a, b;
+	float radius;
+};
+
+class ColliderSet
+{
+public:
+	// Colliders over more cells than this are tested by every point instead
+	static const int maxCellsPerCollider = 512;
+
+	int addSphere(const glm::vec3& centre, float radius);
+	int addCapsule(const glm::vec3& a, const glm::vec3& b, float radius);
+	int addBox(const glm::vec3& centre, const glm::vec3& halfSize);
+	Collider& get(int i) { return colliders[i]; }
+	const Collider& get(int i) const { return colliders[i]; }
+	int size() const { return (int)colliders.size(); }
+	void clear();
+
+	// Rehashes the colliders. cellSize 0 sizes cells to the average collider.
+	void build(float cellSize = 0.0f);
+	// Pushes a point out of any collider it is in and reflects its velocity
+	void collide(glm::vec3& pos, glm::vec3& vel) const;
+	// Box around c grown by colliderBuffer, everything collide() can push
+	static void bounds(const Collider& c, glm::vec3& lo, glm::vec3& hi);
+
+private:
+	uint32_t cellOf(const glm::vec3& p, int axis) const { return (uint32_t)(int)std::floor(p[axis] * invCellSize); }
+	uint32_t bucket(uint32_t x, uint32_t y, uint32_t z) const { return ((x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u)) & (numBuckets - 1); }
+	template <typename Fn>
+	void forEachBucket(const Collider& c, Fn fn) const;
+	void collideWith(const Collider& c, glm::vec3& pos, glm::vec3& vel) const;
+
+	std::vector<Collider> colliders;
+	float invCellSize = 1.0f;
+	uint32_t numBuckets = 1;
+	// Colliders of bucket b are bucketColliders[bucketStart[b] .. bucketStart[b + 1])
+	std::vector<uint32_t> bucketStart = std::vector<uint32_t>(2, 0);
+	std::vector<uint32_t> bucketColliders;
+	std::vector<uint32_t> bucketFill;
+	// Cells each collider covers, 0 if it is on the large list
+	std::vector<uint32_t> colliderCells;
+	// Colliders too big to hash
+	std::vector<uint32_t> large;
+};
+
+#endif
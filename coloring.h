@@ -0,0 +1,73 @@
+#ifndef COLORING_H
+#define COLORING_H
+
+// Graph coloring of cloth elements (springs, faces). Elements of the same
+// color never share a point, so a whole color class can be processed in any
+// order, or by many threads at once, and still write each point's
+// accumulators exactly once - no atomics or locks, and the same result as a
+// serial loop over the classes.
+
+#include <cstdint>
+#include <vector>
+
+const int maxColors = 64;
+
+// Greedily colors numElements elements of elementSize points each.
+// vertexOf(e, k) returns the k-th point of element e. Writes each element's
+// color to colorOf and returns the number of colors used, or -1 if more than
+// maxColors would be needed.
+template <typename VertexOf>
+int colorElements(int numElements, int elementSize, int numVertices, VertexOf vertexOf, int* colorOf)
+{
+	// Bit c of usedColors[p] is set once a color c element touches point p
+	std::vector<uint64_t> usedColors(numVertices, 0);
+	int numColors = 0;
+	for (int e = 0; e < numElements; e++)
+	{
+		uint64_t used = 0;
+		for (int k = 0; k < elementSize; k++)
+			used |= usedColors[vertexOf(e, k)];
+
+		int c = 0;
+		while (c < maxColors && (used & (uint64_t(1) << c)))
+			c++;
+		if (c == maxColors)
+			return -1;
+
+		colorOf[e] = c;
+		for (int k = 0; k < elementSize; k++)
+			usedColors[vertexOf(e, k)] |= uint64_t(1) << c;
+		if (c + 1 > numColors)
+			numColors = c + 1;
+	}
+	return numColors;
+}
+
+// Builds the order that groups elements by color, keeping their relative
+// order within a color, and fills colorStart so color c is
+// order[colorStart[c]] .. order[colorStart[c + 1] - 1].
+inline void sortByColor(int numElements, const int* colorOf, int numColors, int* colorStart, std::vector<int>& order)
+{
+	for (int c = 0; c <= numColors; c++)
+		colorStart[c] = 0;
+	for (int e = 0; e < numElements; e++)
+		colorStart[colorOf[e] + 1]++;
+	for (int c = 0; c < numColors; c++)
+		colorStart[c + 1] += colorStart[c];
+
+	order.assign(numElements, 0);
+	std::vector<int> next(colorStart, colorStart + numColors);
+	for (int e = 0; e < numElements; e++)
+		order[next[colorOf[e]]++] = e;
+}
+
+// Reorders an array so element i becomes old element order[i]
+template <typename T>
+void applyOrder(T* values, const std::vector<int>& order)
+{
+	std::vector<T> old(values, values + order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		values[i] = old[order[i]];
+}
+
+#endif
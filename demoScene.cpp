@@ -0,0 +1,27 @@
+#include "demoScene.h"
+
+#include "clothGrid.h"
+#include "clothSolver.h"
+
+bool buildDemoScene(Scene& scene)
+{
+	// The flag, plus a row of small banners hung by their top corners behind
+	// it. Any Cloth works here, e.g. a ClothGrid<32, 32> for a fixed size flag.
+	ClothParams clothParams;
+	clothParams.selfCollision = true;
+	clothParams.sleeping = true;
+	if (!scene.add(std::unique_ptr<Cloth>(new ClothSolver()), clothParams))
+		return false;
+	for (int b = 0; b < 3; b++)
+	{
+		ClothParams bannerParams;
+		bannerParams.rows = 16;
+		bannerParams.columns = 16;
+		bannerParams.scale = 1.5f;
+		bannerParams.origin = glm::vec3(3.0f + 3.2f * b, 5.0f, -3.0f);
+		bannerParams.pins = { 0, 15 * 16 };
+		if (!scene.add(std::unique_ptr<Cloth>(new ClothGrid<16, 16>()), bannerParams))
+			return false;
+	}
+	return true;
+}
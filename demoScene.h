@@ -0,0 +1,13 @@
+#ifndef DEMO_SCENE_H
+#define DEMO_SCENE_H
+
+// The scene the window shows, built in one place so headless replays of
+// recorded input (see inputLog.h) step exactly the same cloths.
+
+#include "scene.h"
+
+// Adds the flag and the banners to an empty scene, returns false if any of
+// them can't be set up
+bool buildDemoScene(Scene& scene);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef FIXED_STEP_H
+#define FIXED_STEP_H
+
+// Turns wall clock frame times into a whole number of fixed size physics
+// steps, so simulated time keeps up with real time whatever the frame rate.
+// Whatever is left over is carried to the next frame and tells the renderer
+// how far to blend between the last two physics states.
+
+#include <cmath>
+
+struct FixedStepClock
+{
+	// simulated seconds per substep
+	float step = 0.001f;
+	// most substeps run in one frame, time beyond that is dropped so a slow
+	// frame can't make the next one slower still
+	int maxSubsteps = 64;
+	// time not simulated yet
+	float accumulator = 0.0f;
+
+	// Adds a frame's time and returns how many substeps to run for it
+	int advance(float frameTime)
+	{
+		if (frameTime > 0.0f)
+			accumulator += frameTime;
+		int substeps = (int)(accumulator / step);
+		if (substeps > maxSubsteps)
+		{
+			substeps = maxSubsteps;
+			accumulator = std::fmod(accumulator, step);
+		}
+		else
+			accumulator -= substeps * step;
+		return substeps;
+	}
+
+	// Where the current time sits between the last two physics states, 0 to 1
+	float alpha() const
+	{
+		float a = accumulator / step;
+		return a < 1.0f ? a : 1.0f;
+	}
+};
+
+#endif
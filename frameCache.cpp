@@ -0,0 +1,340 @@
+#include "frameCache.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// File layout: header, chunks back to back, the index (one FrameCacheChunk
+// per chunk) and a footer pointing at the index. A chunk is its frames' varints
+// back to back, every x of a frame, then every y, then every z.
+
+static const char frameCacheMagic[8] = { 'C', 'L', 'O', 'T', 'H', 'F', 'R', 'C' };
+
+struct FrameCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numPoints;
+	uint32_t framesPerChunk;
+	float precision;
+};
+
+struct FrameCacheFooter
+{
+	uint64_t indexOffset;
+	uint32_t numChunks;
+	uint32_t numFrames;
+	char magic[8];
+};
+
+static int64_t quantize(float value, double invPrecision)
+{
+	// Far outside the scene, or NaN after a blow up, clamps rather than overflowing
+	double q = std::floor(value * invPrecision + 0.5);
+	if (!(q > -1e15))
+		return q != q ? 0 : -(int64_t)1e15;
+	if (q > 1e15)
+		return (int64_t)1e15;
+	return (int64_t)q;
+}
+
+// Where the point would be if it kept moving as it did between the last
+// two frames, from nothing on a chunk's first frame
+static int64_t predict(int frameInChunk, int64_t last, int64_t beforeLast)
+{
+	if (frameInChunk == 0)
+		return 0;
+	if (frameInChunk == 1)
+		return last;
+	return 2 * last - beforeLast;
+}
+
+// Small residuals of either sign to small unsigned values: 0, -1, 1, -2 ...
+static uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Seven bits per byte, low bits first, high bit set on every byte but the last
+static void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static bool getVarint(const std::vector<uint8_t>& in, size_t& pos, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (pos >= in.size())
+			return false;
+		uint8_t byte = in[pos++];
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+bool FrameCache::open(const char* path, int points, float framePrecision)
+{
+	close();
+	if (points <= 0 || !(framePrecision > 0.0f))
+		return false;
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	numPoints = points;
+	precision = framePrecision;
+	FrameCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, frameCacheMagic, sizeof(frameCacheMagic));
+	header.version = frameCacheVersion;
+	header.numPoints = numPoints;
+	header.framesPerChunk = framesPerChunk;
+	header.precision = precision;
+	file.write((const char*)&header, sizeof(header));
+	bytesWritten.store(sizeof(header), std::memory_order_release);
+
+	for (int b = 0; b < numBuffers; b++)
+	{
+		buffers[b].resize(3 * (size_t)numPoints);
+		empty.push(b);
+	}
+	last.assign(3 * (size_t)numPoints, 0);
+	beforeLast.assign(3 * (size_t)numPoints, 0);
+	chunk.clear();
+	chunkFrames = 0;
+	index.clear();
+	failed = !file;
+	recorded = dropped = stalls = 0;
+	quit.store(false, std::memory_order_release);
+	writer = std::thread(&FrameCache::writerLoop, this);
+	return true;
+}
+
+bool FrameCache::close()
+{
+	if (!writer.joinable())
+		return !failed;
+	quit.store(true, std::memory_order_release);
+	writer.join();
+
+	flushChunk();
+	FrameCacheFooter footer;
+	std::memset(&footer, 0, sizeof(footer));
+	footer.indexOffset = bytesWritten.load(std::memory_order_relaxed);
+	footer.numChunks = (uint32_t)index.size();
+	footer.numFrames = 0;
+	for (const FrameCacheChunk& entry : index)
+		footer.numFrames += entry.numFrames;
+	std::memcpy(footer.magic, frameCacheMagic, sizeof(frameCacheMagic));
+	file.write((const char*)index.data(), sizeof(FrameCacheChunk) * index.size());
+	file.write((const char*)&footer, sizeof(footer));
+	bytesWritten.fetch_add(sizeof(FrameCacheChunk) * index.size() + sizeof(footer), std::memory_order_release);
+	file.close();
+	failed = failed || file.fail();
+
+	// Take the buffers back so the ring is empty for the next open()
+	int b;
+	while (empty.pop(b))
+		;
+	return !failed;
+}
+
+bool FrameCache::record(const Scene& scene, bool wait)
+{
+	if (!writer.joinable() || scene.getNumPoints() != numPoints)
+		return false;
+	int b;
+	if (!empty.pop(b))
+	{
+		if (!wait)
+		{
+			dropped++;
+			return false;
+		}
+		stalls++;
+		while (!empty.pop(b))
+			std::this_thread::yield();
+	}
+
+	float* frame = buffers[b].data();
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		const ParticleArrays& particles = cloth.getParticles();
+		size_t first = scene.getFirstPoint(c);
+		size_t count = cloth.getNumPoints();
+		std::memcpy(frame + first, particles.posX, sizeof(float) * count);
+		std::memcpy(frame + numPoints + first, particles.posY, sizeof(float) * count);
+		std::memcpy(frame + 2 * (size_t)numPoints + first, particles.posZ, sizeof(float) * count);
+	}
+	full.push(b);
+	recorded++;
+	return true;
+}
+
+size_t FrameCache::getMemoryUsed() const
+{
+	return sizeof(*this) + sizeof(float) * buffers[0].size() * numBuffers
+		+ sizeof(int64_t) * (last.capacity() + beforeLast.capacity()) + chunk.capacity();
+}
+
+void FrameCache::writerLoop()
+{
+	while (true)
+	{
+		// Read quit first so nothing pushed before it was set is missed
+		bool stopping = quit.load(std::memory_order_acquire);
+		int b;
+		bool any = false;
+		while (full.pop(b))
+		{
+			encode(buffers[b].data());
+			empty.push(b);
+			any = true;
+		}
+		if (stopping)
+			break;
+		// A millisecond holds a frame or two at simulation rates, well under numBuffers
+		if (!any)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void FrameCache::encode(const float* frame)
+{
+	double invPrecision = 1.0 / precision;
+	for (size_t i = 0; i < 3 * (size_t)numPoints; i++)
+	{
+		int64_t q = quantize(frame[i], invPrecision);
+		putVarint(chunk, zigzag(q - predict(chunkFrames, last[i], beforeLast[i])));
+		beforeLast[i] = last[i];
+		last[i] = q;
+	}
+	if (++chunkFrames == framesPerChunk)
+		flushChunk();
+}
+
+void FrameCache::flushChunk()
+{
+	if (chunkFrames == 0)
+		return;
+	FrameCacheChunk entry;
+	entry.offset = bytesWritten.load(std::memory_order_relaxed);
+	entry.size = (uint32_t)chunk.size();
+	entry.numFrames = chunkFrames;
+	index.push_back(entry);
+	file.write((const char*)chunk.data(), chunk.size());
+	failed = failed || !file;
+	bytesWritten.fetch_add(chunk.size(), std::memory_order_release);
+	chunk.clear();
+	chunkFrames = 0;
+}
+
+bool FrameCacheReader::open(const char* path)
+{
+	file.close();
+	file.clear();
+	numPoints = numFrames = 0;
+	loadedChunk = decodedFrame = -1;
+	file.open(path, std::ios::binary);
+	FrameCacheHeader header;
+	FrameCacheFooter footer;
+	if (!file.read((char*)&header, sizeof(header)))
+		return false;
+	if (std::memcmp(header.magic, frameCacheMagic, sizeof(frameCacheMagic)) != 0 || header.version != frameCacheVersion ||
+		header.framesPerChunk != FrameCache::framesPerChunk || header.numPoints == 0 || !(header.precision > 0.0f))
+		return false;
+	if (!file.seekg(-(std::streamoff)sizeof(footer), std::ios::end) || !file.read((char*)&footer, sizeof(footer)) ||
+		std::memcmp(footer.magic, frameCacheMagic, sizeof(frameCacheMagic)) != 0)
+		return false;
+	// The index sits right before the footer
+	uint64_t indexEnd = (uint64_t)file.tellg() - sizeof(footer);
+	if (footer.indexOffset > indexEnd || footer.numChunks != (indexEnd - footer.indexOffset) / sizeof(FrameCacheChunk))
+		return false;
+
+	index.resize(footer.numChunks);
+	if (!file.seekg((std::streamoff)footer.indexOffset) ||
+		!file.read((char*)index.data(), sizeof(FrameCacheChunk) * index.size()))
+		return false;
+	uint64_t frames = 0;
+	for (size_t c = 0; c < index.size(); c++)
+	{
+		// Every chunk but the last is full, so frame f is in chunk f / framesPerChunk
+		if (index[c].offset > footer.indexOffset || index[c].size > footer.indexOffset - index[c].offset ||
+			(c + 1 < index.size() && index[c].numFrames != FrameCache::framesPerChunk))
+			return false;
+		frames += index[c].numFrames;
+	}
+	if (frames != footer.numFrames)
+		return false;
+
+	numPoints = header.numPoints;
+	numFrames = footer.numFrames;
+	precision = header.precision;
+	last.assign(3 * (size_t)numPoints, 0);
+	beforeLast.assign(3 * (size_t)numPoints, 0);
+	return true;
+}
+
+bool FrameCacheReader::loadChunk(int c)
+{
+	chunk.resize(index[c].size);
+	loadedChunk = -1;
+	if (!file.seekg((std::streamoff)index[c].offset) || !file.read((char*)chunk.data(), chunk.size()))
+		return false;
+	loadedChunk = c;
+	decodedFrame = c * FrameCache::framesPerChunk - 1;
+	readPos = 0;
+	return true;
+}
+
+bool FrameCacheReader::readFrame(int frame, float* posX, float* posY, float* posZ)
+{
+	if (frame < 0 || frame >= numFrames)
+		return false;
+	int c = frame / FrameCache::framesPerChunk;
+	if (c != loadedChunk || frame <= decodedFrame)
+	{
+		if (!loadChunk(c))
+			return false;
+	}
+
+	// Decode up to the frame, each one predicted from the two before
+	while (decodedFrame < frame)
+	{
+		int frameInChunk = decodedFrame + 1 - c * FrameCache::framesPerChunk;
+		for (size_t i = 0; i < 3 * (size_t)numPoints; i++)
+		{
+			uint64_t value;
+			if (!getVarint(chunk, readPos, value))
+			{
+				loadedChunk = -1;
+				return false;
+			}
+			int64_t q = predict(frameInChunk, last[i], beforeLast[i]) + unzigzag(value);
+			beforeLast[i] = last[i];
+			last[i] = q;
+		}
+		decodedFrame++;
+	}
+
+	float* out[3] = { posX, posY, posZ };
+	for (int axis = 0; axis < 3; axis++)
+		for (int i = 0; i < numPoints; i++)
+			out[axis][i] = (float)(last[axis * (size_t)numPoints + i] * (double)precision);
+	return true;
+}
@@ -0,0 +1,141 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+// Streams the scene's positions to disk every frame for offline rendering
+// and analysis. record() only copies the positions into a free buffer and
+// hands it to a writer thread through a lock free ring, the encoding and
+// the disk writes happen there.
+//
+// Positions are rounded to a grid of precision metres, so every decoded
+// position is within half of precision (plus float rounding) of the recorded
+// one, however long the cache. Each frame stores, per coordinate, how far
+// the rounded value is from a prediction made from the previous two frames
+// (the point keeps moving as it did). Cloth moves smoothly, so most of these
+// residuals are a few grid steps. They are zigzag mapped to unsigned and
+// written as varints, one to three bytes each instead of four.
+//
+// Frames are grouped into chunks of framesPerChunk. The first frame of a
+// chunk is predicted from nothing, so every chunk decodes on its own. close()
+// writes an index of the chunks after the last one, which FrameCacheReader
+// uses to seek to any frame. A cache that was never closed has no index.
+//
+// Values are stored in the machine's own byte order.
+
+#include "scene.h"
+#include "spscRing.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+const uint32_t frameCacheVersion = 1;
+
+// Where a chunk is in the file, one per chunk in the index
+struct FrameCacheChunk
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t numFrames;
+};
+
+class FrameCache
+{
+public:
+	static const int framesPerChunk = 64;
+
+	FrameCache() : quit(false), bytesWritten(0) {}
+	~FrameCache() { close(); }
+	FrameCache(const FrameCache&) = delete;
+	FrameCache& operator=(const FrameCache&) = delete;
+
+	// Starts a cache of numPoints points at path and the writer thread.
+	// Positions are kept to the nearest multiple of precision metres.
+	bool open(const char* path, int numPoints, float precision = 1e-4f);
+	// Writes out everything recorded so far and the index, then stops the
+	// writer thread. Returns false if any write failed.
+	bool close();
+	bool isOpen() const { return writer.joinable(); }
+
+	// Hands the positions of every point of scene to the writer thread. If
+	// every buffer is waiting to be written, waits for one when wait is set
+	// and otherwise drops the frame and returns false.
+	bool record(const Scene& scene, bool wait = true);
+
+	// Frames recorded and dropped, and times record() had to wait
+	int getRecorded() const { return recorded; }
+	int getDropped() const { return dropped; }
+	int getStalls() const { return stalls; }
+	// Bytes written so far, the index only counts once close() returns
+	uint64_t getBytesWritten() const { return bytesWritten.load(std::memory_order_acquire); }
+	size_t getMemoryUsed() const;
+
+private:
+	static const int numBuffers = 16;
+
+	void writerLoop();
+	void encode(const float* frame);
+	void flushChunk();
+
+	int numPoints = 0;
+	float precision = 1e-4f;
+	// posX, then posY, then posZ of every point, per buffer
+	std::vector<float> buffers[numBuffers];
+	// Buffers waiting to be written, and buffers free to record into
+	SpscRing<int, numBuffers> full;
+	SpscRing<int, numBuffers> empty;
+	std::atomic<bool> quit;
+	std::atomic<uint64_t> bytesWritten;
+
+	// Recording thread only
+	int recorded = 0;
+	int dropped = 0;
+	int stalls = 0;
+
+	// Writer thread only
+	std::ofstream file;
+	bool failed = false;
+	// Rounded positions of the last two frames, to predict from
+	std::vector<int64_t> last, beforeLast;
+	int chunkFrames = 0;
+	std::vector<uint8_t> chunk;
+	std::vector<FrameCacheChunk> index;
+
+	std::thread writer;
+};
+
+// Reads back a closed cache. Reading frames in order only decodes each once,
+// jumping around decodes from the start of the frame's chunk.
+class FrameCacheReader
+{
+public:
+	// Returns false if path can't be read or isn't a closed cache of this version
+	bool open(const char* path);
+	int getNumPoints() const { return numPoints; }
+	int getNumFrames() const { return numFrames; }
+	float getPrecision() const { return precision; }
+
+	// Positions of every point in frame, false if it is out of range or the
+	// file is damaged
+	bool readFrame(int frame, float* posX, float* posY, float* posZ);
+
+private:
+	bool loadChunk(int c);
+
+	std::ifstream file;
+	int numPoints = 0;
+	int numFrames = 0;
+	float precision = 0.0f;
+	std::vector<FrameCacheChunk> index;
+
+	// The chunk being decoded, the frame decoded last and where the next
+	// one starts
+	int loadedChunk = -1;
+	std::vector<uint8_t> chunk;
+	int decodedFrame = -1;
+	size_t readPos = 0;
+	std::vector<int64_t> last, beforeLast;
+};
+
+#endif
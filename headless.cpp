@@ -0,0 +1,489 @@
+// Headless cloth runner --------------------
+//
+// Steps the cloth a fixed number of times as fast as possible without
+// opening a window, then prints the throughput and a checksum of the final
+// positions. Only needs glm, so it builds on machines with no GPU, e.g.
+//   g++ -O2 -std=c++14 -pthread -I<glm include dir> adaptiveStep.cpp clothSolver.cpp clothSolverImplicit.cpp clothSolverSelf.cpp clothSolverSleep.cpp clothSolverXpbd.cpp colliders.cpp demoScene.cpp frameCache.cpp inputLog.cpp multiresCloth.cpp scene.cpp simThread.cpp snapshot.cpp triangleBvh.cpp springKernels.cpp jobSystem.cpp headless.cpp -o clothHeadless
+//
+// usage: clothHeadless [--steps n] [--dt seconds] [--rows n] [--columns n]
+//                      [--simd scalar|avx2|avx512] [--threads n] [--grain n]
+//                      [--grid 16|30|32] [--integrator verlet|euler|implicit|xpbd]
+//                      [--iterations n] [--colliders n] [--self-collision 0|1]
+//                      [--cloths n] [--load file] [--save file]
+//                      [--cache file] [--cache-every n] [--cache-precision metres]
+//                      [--replay file] [--precision float|double] [--compare n]
+//                      [--adaptive 0|1] [--max-step seconds] [--tolerance metres]
+//                      [--sleep 0|1] [--sleep-speed m/s] [--sleep-steps n] [--sleep-tile n]
+//                      [--multires level] [--multires-iterations n]
+//
+// --grid steps a fixed size ClothGrid instead of the runtime sized solver.
+// --colliders scatters n spheres, capsules and boxes under the cloth.
+// --cloths steps n copies of the cloth side by side in one scene, the
+// checksum covers all of them.
+// --load starts from a snapshot of the same scene instead of the flat
+// cloth, --save writes one after the last step.
+// --cache records positions every --cache-every steps to a frame cache,
+// see frameCache.h.
+// --replay steps the window's scene through input recorded in it (F6) and
+// checks it ends exactly as the recording did, see inputLog.h. Only
+// --threads and --simd apply to it.
+// --precision double steps the runtime sized solver in double, see
+// clothSolver.h.
+// --compare steps the cloth in float and in double side by side and prints
+// how far apart their points are every n steps, to tell float round-off from
+// instability of the model. Exits with 2 if either blows up.
+// --adaptive simulates as long as --steps steps of --dt would, in steps of
+// up to --max-step picked by an AdaptiveStepController, see adaptiveStep.h.
+// --tolerance is the position error it allows per step.
+// --sleep stops stepping tiles of --sleep-tile points that moved slower than
+// --sleep-speed for --sleep-steps steps, see clothSolverSleep.cpp.
+// --multires simulates the cloth on a grid 2^level times coarser and fills
+// in the rest with --multires-iterations correction passes, see
+// multiresCloth.h.
+
+#include "adaptiveStep.h"
+#include "clothGrid.h"
+#include "clothSolver.h"
+#include "demoScene.h"
+#include "frameCache.h"
+#include "inputLog.h"
+#include "multiresCloth.h"
+#include "scene.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+// Props of random size spread under where the cloth starts, the same ones every run
+static void scatterColliders(ColliderSet& colliders, int n, const ClothParams& params)
+{
+	uint32_t seed = 12345;
+	auto random = [&seed](float lo, float hi)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return lo + (hi - lo) * ((seed >> 8) / 16777216.0f);
+	};
+	for (int i = 0; i < n; i++)
+	{
+		glm::vec3 pos(random(3.0f, 3.0f + params.scale * 1.92f), random(0.5f, 5.0f), random(3.0f - params.scale * 1.22f, 3.0f));
+		float size = random(0.05f, 0.3f);
+		if (i % 3 == 0)
+			colliders.addSphere(pos, size);
+		else if (i % 3 == 1)
+			colliders.addCapsule(pos, pos + glm::vec3(random(-0.5f, 0.5f), 0.0f, random(-0.5f, 0.5f)), size * 0.5f);
+		else
+			colliders.addBox(pos, glm::vec3(size, size * 0.5f, size));
+	}
+	colliders.build();
+}
+
+// Replays recorded input on the window's scene, see inputLog.h
+static int replay(const char* path, const ClothParams& clothParams)
+{
+	InputLog log;
+	if (!log.open(path))
+	{
+		std::cout << "Failed to read a recording from " << path << std::endl;
+		return 1;
+	}
+	Scene scene(clothParams.threads);
+	if (!buildDemoScene(scene))
+	{
+		std::cout << "Failed to set up the scene" << std::endl;
+		return 1;
+	}
+	// Taken up when the replay sets the cloths up again from the recording
+	for (int c = 0; c < scene.getNumCloths(); c++)
+		scene.getCloth(c).getParams().simd = clothParams.simd;
+
+	auto start = std::chrono::steady_clock::now();
+	bool matched;
+	if (!log.replay(scene, matched))
+	{
+		std::cout << "Failed to restore the start of " << path << " (" << path << ".snp)" << std::endl;
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "replay: " << path << " inputs: " << log.getEvents().size() << " steps: " << log.getNumSteps()
+		<< " cloths: " << scene.getNumCloths() << " points: " << scene.getNumPoints() << std::endl;
+	std::cout << "time: " << seconds << " s (" << log.getNumSteps() / seconds << " steps/s)" << std::endl;
+	StepTimes times = scene.getStepTimes();
+	std::cout << "springs: " << times.springs << " s faces: " << times.faces << " s points: " << times.points << " s" << std::endl;
+	std::cout << (matched ? "end state matches the recording" : "end state differs from the recording") << std::endl;
+	return matched ? 0 : 2;
+}
+
+// Kernel, threads and colors of a runtime sized solver, either precision
+template <typename Scalar>
+static void printSolver(const BasicClothSolver<Scalar>& solver)
+{
+	std::cout << " kernel: " << simdLevelName(solver.getSimdLevel()) << " threads: " << solver.getThreadCount()
+		<< " spring colors: " << solver.getNumSpringColors();
+	if (solver.getParams().integrator == INTEGRATOR_IMPLICIT)
+		std::cout << " cg iterations: " << solver.getSolverIterations();
+	if (solver.getParams().sleeping)
+		std::cout << " tiles asleep: " << solver.getNumAsleep() << " of " << solver.getNumTiles();
+}
+
+// Steps the same cloth in float and in double and reports how far apart
+// they are every n steps
+static int compare(int steps, int every, float dt, int numColliders, const ClothParams& clothParams)
+{
+	Scene floatScene(clothParams.threads), doubleScene(clothParams.threads);
+	ClothSolver* floatSolver = new ClothSolver();
+	ClothSolverDouble* doubleSolver = new ClothSolverDouble();
+	if (numColliders > 0)
+	{
+		scatterColliders(floatScene.getColliders(), numColliders, clothParams);
+		scatterColliders(doubleScene.getColliders(), numColliders, clothParams);
+	}
+	if (!floatScene.add(std::unique_ptr<Cloth>(floatSolver), clothParams) ||
+		!doubleScene.add(std::unique_ptr<Cloth>(doubleSolver), clothParams))
+	{
+		std::cout << "Failed to set up a " << clothParams.rows << "x" << clothParams.columns << " cloth" << std::endl;
+		return 1;
+	}
+
+	std::cout << "comparing float and double, " << floatSolver->getNumPoints() << " points dt: " << dt << std::endl;
+	std::cout.precision(4);
+	double worst = 0.0;
+	int worstStep = 0;
+	for (int done = 0; done < steps;)
+	{
+		int n = std::min(every, steps - done);
+		floatScene.step(dt, n);
+		doubleScene.step(dt, n);
+		done += n;
+
+		const ParticleArrays& a = floatSolver->getParticles();
+		const BasicParticleArrays<double>& b = doubleSolver->getExactParticles();
+		double largest = 0.0, sum = 0.0;
+		bool floatFinite = true, doubleFinite = true;
+		int numPoints = floatSolver->getNumPoints();
+		for (int i = 0; i < numPoints; i++)
+		{
+			floatFinite = floatFinite && std::isfinite(a.posX[i] + a.posY[i] + a.posZ[i]);
+			doubleFinite = doubleFinite && std::isfinite(b.posX[i] + b.posY[i] + b.posZ[i]);
+			double d = glm::length(glm::dvec3(a.pos(i)) - b.pos(i));
+			largest = std::max(largest, d);
+			sum += d * d;
+		}
+		// Both blowing up is the model or the step, float alone is round-off
+		if (!floatFinite || !doubleFinite)
+		{
+			std::cout << "step " << done << ": " << (floatFinite ? "double" : doubleFinite ? "float" : "float and double")
+				<< " blew up" << std::endl;
+			return 2;
+		}
+		std::cout << "step " << done << ": max " << largest << " m rms " << std::sqrt(sum / numPoints) << " m" << std::endl;
+		if (largest > worst)
+		{
+			worst = largest;
+			worstStep = done;
+		}
+	}
+	std::cout << "largest divergence: " << worst << " m at step " << worstStep << std::endl;
+	return 0;
+}
+
+// Steps scene through duration seconds in steps of controller's choosing.
+// Returns the steps taken and the shortest and longest of them.
+static int stepAdaptive(Scene& scene, AdaptiveStepController& controller, double duration, float& shortest, float& longest)
+{
+	controller.reset(scene);
+	shortest = longest = controller.getStep();
+	int taken = 0;
+	double time = 0.0;
+	while (time < duration)
+	{
+		float step = controller.getStep();
+		int n = std::min(controller.params.interval, std::max(1, (int)std::ceil((duration - time) / step)));
+		scene.step(step, n);
+		taken += n;
+		time += (double)n * step;
+		float next = controller.update(scene, n);
+		if (next != step)
+			scene.changeStepLength(step, next);
+		shortest = std::min(shortest, next);
+		longest = std::max(longest, next);
+	}
+	return taken;
+}
+
+int main(int argc, char** argv)
+{
+	int steps = 10000;
+	float dt = 0.001f;
+	int grid = 0;
+	int numColliders = 0;
+	int numCloths = 1;
+	const char* loadPath = nullptr;
+	const char* savePath = nullptr;
+	const char* cachePath = nullptr;
+	const char* replayPath = nullptr;
+	int cacheEvery = 1;
+	float cachePrecision = 1e-4f;
+	bool useDouble = false;
+	int compareEvery = 0;
+	bool adaptive = false;
+	bool multires = false;
+	AdaptiveStepController controller;
+	ClothParams clothParams;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const char* arg = argv[i];
+		const char* value = argv[i + 1];
+		if (std::strcmp(arg, "--steps") == 0)
+			steps = std::atoi(value);
+		else if (std::strcmp(arg, "--dt") == 0)
+			dt = (float)std::atof(value);
+		else if (std::strcmp(arg, "--rows") == 0)
+			clothParams.rows = std::atoi(value);
+		else if (std::strcmp(arg, "--columns") == 0)
+			clothParams.columns = std::atoi(value);
+		else if (std::strcmp(arg, "--simd") == 0)
+		{
+			if (std::strcmp(value, "scalar") == 0)
+				clothParams.simd = SIMD_SCALAR;
+			else if (std::strcmp(value, "avx2") == 0)
+				clothParams.simd = SIMD_AVX2;
+			else
+				clothParams.simd = SIMD_AVX512;
+		}
+		else if (std::strcmp(arg, "--threads") == 0)
+			clothParams.threads = std::atoi(value);
+		else if (std::strcmp(arg, "--grain") == 0)
+			clothParams.grainSize = std::atoi(value);
+		else if (std::strcmp(arg, "--integrator") == 0)
+		{
+			if (std::strcmp(value, "euler") == 0)
+				clothParams.integrator = INTEGRATOR_EULER;
+			else if (std::strcmp(value, "implicit") == 0)
+				clothParams.integrator = INTEGRATOR_IMPLICIT;
+			else if (std::strcmp(value, "xpbd") == 0)
+				clothParams.integrator = INTEGRATOR_XPBD;
+			else
+				clothParams.integrator = INTEGRATOR_VERLET;
+		}
+		else if (std::strcmp(arg, "--iterations") == 0)
+			clothParams.xpbdIterations = clothParams.cgIterations = std::atoi(value);
+		else if (std::strcmp(arg, "--grid") == 0)
+			grid = std::atoi(value);
+		else if (std::strcmp(arg, "--colliders") == 0)
+			numColliders = std::atoi(value);
+		else if (std::strcmp(arg, "--self-collision") == 0)
+			clothParams.selfCollision = std::atoi(value) != 0;
+		else if (std::strcmp(arg, "--sleep") == 0)
+			clothParams.sleeping = std::atoi(value) != 0;
+		else if (std::strcmp(arg, "--sleep-speed") == 0)
+			clothParams.sleepSpeed = (float)std::atof(value);
+		else if (std::strcmp(arg, "--sleep-steps") == 0)
+			clothParams.sleepSteps = std::atoi(value);
+		else if (std::strcmp(arg, "--sleep-tile") == 0)
+			clothParams.sleepTile = std::atoi(value);
+		else if (std::strcmp(arg, "--multires") == 0)
+		{
+			multires = true;
+			clothParams.multiresLevel = std::atoi(value);
+		}
+		else if (std::strcmp(arg, "--multires-iterations") == 0)
+			clothParams.multiresIterations = std::atoi(value);
+		else if (std::strcmp(arg, "--cloths") == 0)
+			numCloths = std::atoi(value);
+		else if (std::strcmp(arg, "--load") == 0)
+			loadPath = value;
+		else if (std::strcmp(arg, "--save") == 0)
+			savePath = value;
+		else if (std::strcmp(arg, "--cache") == 0)
+			cachePath = value;
+		else if (std::strcmp(arg, "--cache-every") == 0)
+			cacheEvery = std::atoi(value) > 0 ? std::atoi(value) : 1;
+		else if (std::strcmp(arg, "--cache-precision") == 0)
+			cachePrecision = (float)std::atof(value);
+		else if (std::strcmp(arg, "--replay") == 0)
+			replayPath = value;
+		else if (std::strcmp(arg, "--precision") == 0)
+			useDouble = std::strcmp(value, "double") == 0;
+		else if (std::strcmp(arg, "--compare") == 0)
+			compareEvery = std::atoi(value);
+		else if (std::strcmp(arg, "--adaptive") == 0)
+			adaptive = std::atoi(value) != 0;
+		else if (std::strcmp(arg, "--max-step") == 0)
+			controller.params.maxStep = (float)std::atof(value);
+		else if (std::strcmp(arg, "--tolerance") == 0)
+			controller.params.tolerance = (float)std::atof(value);
+		else
+		{
+			std::cout << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	if (replayPath)
+		return replay(replayPath, clothParams);
+	if (compareEvery > 0)
+		return compare(steps, compareEvery, dt, numColliders, clothParams);
+	if (numCloths < 1)
+	{
+		std::cout << "--cloths needs at least one cloth" << std::endl;
+		return 1;
+	}
+	if (adaptive && cachePath)
+	{
+		std::cout << "--cache needs fixed steps, it records every --cache-every of them" << std::endl;
+		return 1;
+	}
+
+	Scene scene(clothParams.threads);
+	if (numColliders > 0)
+		scatterColliders(scene.getColliders(), numColliders, clothParams);
+
+	ClothSolver* solver = nullptr;
+	ClothSolverDouble* doubleSolver = nullptr;
+	MultiresCloth* multiresCloth = nullptr;
+	for (int c = 0; c < numCloths; c++)
+	{
+		std::unique_ptr<Cloth> cloth;
+		if (grid == 16)
+			cloth.reset(new ClothGrid<16, 16>());
+		else if (grid == 30)
+			cloth.reset(new ClothGrid<30, 30>());
+		else if (grid == 32)
+			cloth.reset(new ClothGrid<32, 32>());
+		else if (multires)
+		{
+			multiresCloth = new MultiresCloth();
+			cloth.reset(multiresCloth);
+		}
+		else if (useDouble)
+		{
+			doubleSolver = new ClothSolverDouble();
+			cloth.reset(doubleSolver);
+		}
+		else
+		{
+			solver = new ClothSolver();
+			cloth.reset(solver);
+		}
+
+		// Side by side with a gap, so they don't touch
+		ClothParams params = clothParams;
+		params.origin.x += c * clothParams.scale * 2.5f;
+		if (!scene.add(std::move(cloth), params))
+		{
+			std::cout << "Failed to set up a " << clothParams.rows << "x" << clothParams.columns << " cloth" << std::endl;
+			return 1;
+		}
+	}
+
+	if (loadPath)
+	{
+		SnapshotFile snapshot;
+		auto loadStart = std::chrono::steady_clock::now();
+		if (!snapshot.open(loadPath) || !snapshot.restore(scene))
+		{
+			std::cout << "Failed to load a snapshot of this scene from " << loadPath << std::endl;
+			return 1;
+		}
+		double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+		std::cout << "loaded " << loadPath << " (" << snapshot.getSize() / 1024.0 << " KB) in " << loadSeconds * 1000.0 << " ms" << std::endl;
+	}
+
+	FrameCache cache;
+	if (cachePath && !cache.open(cachePath, scene.getNumPoints(), cachePrecision))
+	{
+		std::cout << "Failed to open " << cachePath << " for the frame cache" << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int stepsTaken = steps;
+	float shortest = dt, longest = dt;
+	if (adaptive)
+		stepsTaken = stepAdaptive(scene, controller, (double)steps * dt, shortest, longest);
+	else if (cachePath)
+	{
+		// The first frame is where the run starts
+		cache.record(scene);
+		for (int done = 0; done < steps; done += cacheEvery)
+		{
+			scene.step(dt, std::min(cacheEvery, steps - done));
+			cache.record(scene);
+		}
+	}
+	else
+		scene.step(dt, steps);
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+
+	// Sum of positions so runs can be compared against each other
+	double checksum = 0.0;
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		const ParticleArrays& particles = cloth.getParticles();
+		for (int i = 0; i < cloth.getNumPoints(); i++)
+			checksum += particles.posX[i] + particles.posY[i] + particles.posZ[i];
+	}
+
+	const Cloth& cloth = scene.getCloth(0);
+	std::cout << "cloths: " << scene.getNumCloths() << " of " << cloth.getRows() << "x" << cloth.getColumns() << " points: " << scene.getNumPoints()
+		<< " springs: " << scene.getNumSprings() << " memory: " << scene.getMemoryUsed() / (1024.0 * 1024.0) << " MB" << std::endl;
+	if (adaptive)
+		std::cout << "steps: " << stepsTaken << " for " << steps << " of " << dt << " s, dt: " << shortest << " to " << longest;
+	else
+		std::cout << "steps: " << steps << " dt: " << dt;
+	if (solver)
+		printSolver(*solver);
+	else if (multiresCloth)
+	{
+		const ClothSolver& coarse = multiresCloth->getCoarse();
+		printSolver(coarse);
+		std::cout << " multires level: " << multiresCloth->getLevel() << " of " << coarse.getRows() << "x" << coarse.getColumns();
+	}
+	else if (doubleSolver)
+	{
+		printSolver(*doubleSolver);
+		std::cout << " double precision";
+	}
+	else
+		std::cout << " fixed size grid";
+	std::cout << std::endl;
+	std::cout << "time: " << seconds << " s (" << stepsTaken / seconds << " steps/s)" << std::endl;
+	StepTimes times = scene.getStepTimes();
+	std::cout << "springs: " << times.springs << " s faces: " << times.faces << " s points: " << times.points << " s" << std::endl;
+	std::cout.precision(12);
+	std::cout << "checksum: " << checksum << std::endl;
+
+	if (cachePath)
+	{
+		auto closeStart = std::chrono::steady_clock::now();
+		bool written = cache.close();
+		double closeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - closeStart).count();
+		double raw = 3.0 * sizeof(float) * scene.getNumPoints() * cache.getRecorded();
+		std::cout.precision(3);
+		std::cout << "cache: " << cache.getRecorded() << " frames " << cache.getBytesWritten() / (1024.0 * 1024.0) << " MB ("
+			<< raw / cache.getBytesWritten() << "x smaller than raw) stalls: " << cache.getStalls()
+			<< " finishing: " << closeSeconds << " s" << std::endl;
+		if (!written)
+		{
+			std::cout << "Failed to write " << cachePath << std::endl;
+			return 1;
+		}
+	}
+
+	if (savePath && !saveSnapshot(scene, savePath))
+	{
+		std::cout << "Failed to save a snapshot to " << savePath << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
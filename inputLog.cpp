@@ -0,0 +1,182 @@
+#include "inputLog.h"
+
+#include "simThread.h"
+#include "snapshot.h"
+
+#include <cstring>
+#include <iterator>
+
+// File layout: header, InputEvents, footer
+
+static const char inputLogMagic[8] = { 'C', 'L', 'O', 'T', 'H', 'I', 'N', 'P' };
+
+struct InputLogHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numPoints;
+	float firstStepLength;
+	uint32_t unused;
+};
+
+struct InputLogFooter
+{
+	uint64_t numSteps;
+	uint64_t hash;
+	char magic[8];
+};
+
+static std::string snapshotPathFor(const std::string& path)
+{
+	return path + ".snp";
+}
+
+// FNV-1a over the bits of every value, so any difference at all shows
+uint64_t hashSceneState(const Scene& scene)
+{
+	uint64_t hash = 14695981039346656037ull;
+	float* ParticleArrays::* const fields[] =
+	{
+		&ParticleArrays::posX, &ParticleArrays::posY, &ParticleArrays::posZ,
+		&ParticleArrays::prevX, &ParticleArrays::prevY, &ParticleArrays::prevZ,
+		&ParticleArrays::velX, &ParticleArrays::velY, &ParticleArrays::velZ
+	};
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		const ParticleArrays& particles = cloth.getParticles();
+		for (float* ParticleArrays::* field : fields)
+		{
+			const unsigned char* bytes = (const unsigned char*)(particles.*field);
+			for (size_t i = 0; i < sizeof(float) * cloth.getNumPoints(); i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+		}
+	}
+	return hash;
+}
+
+bool InputRecorder::start(const char* logPath, const Scene& scene, uint64_t step, float stepLength)
+{
+	if (isRecording())
+		return false;
+	path = logPath;
+	if (!saveSnapshot(scene, snapshotPathFor(path).c_str()))
+		return false;
+	file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	InputLogHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, inputLogMagic, sizeof(inputLogMagic));
+	header.version = inputLogVersion;
+	header.numPoints = scene.getNumPoints();
+	header.firstStepLength = stepLength;
+	file.write((const char*)&header, sizeof(header));
+	firstStep = step;
+	return true;
+}
+
+void InputRecorder::record(uint64_t step, const SimInput& input, float stepLength)
+{
+	if (input.type != SimInput::MOVE_SPHERE && input.type != SimInput::SET_INTEGRATOR && input.type != SimInput::SET_CAMERA &&
+		input.type != SimInput::STEP_CHANGED)
+		return;
+	InputEvent event;
+	std::memset(&event, 0, sizeof(event));
+	event.step = step - firstStep;
+	event.type = input.type;
+	event.stepLength = stepLength;
+	const glm::vec3& a = input.type == SimInput::SET_CAMERA ? input.cameraPos : input.offset;
+	event.a[0] = a.x;
+	event.a[1] = a.y;
+	event.a[2] = a.z;
+	if (input.type == SimInput::SET_CAMERA)
+	{
+		event.b[0] = input.cameraFront.x;
+		event.b[1] = input.cameraFront.y;
+		event.b[2] = input.cameraFront.z;
+	}
+	event.integrator = input.integrator;
+	file.write((const char*)&event, sizeof(event));
+}
+
+bool InputRecorder::stop(uint64_t step, const Scene& scene)
+{
+	InputLogFooter footer;
+	std::memset(&footer, 0, sizeof(footer));
+	footer.numSteps = step - firstStep;
+	footer.hash = hashSceneState(scene);
+	std::memcpy(footer.magic, inputLogMagic, sizeof(inputLogMagic));
+	file.write((const char*)&footer, sizeof(footer));
+	file.close();
+	return !file.fail();
+}
+
+bool InputLog::open(const char* logPath)
+{
+	path = logPath;
+	events.clear();
+	std::ifstream file(logPath, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (bytes.size() < sizeof(InputLogHeader) + sizeof(InputLogFooter) ||
+		(bytes.size() - sizeof(InputLogHeader) - sizeof(InputLogFooter)) % sizeof(InputEvent) != 0)
+		return false;
+
+	InputLogHeader header;
+	InputLogFooter footer;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	std::memcpy(&footer, bytes.data() + bytes.size() - sizeof(footer), sizeof(footer));
+	if (std::memcmp(header.magic, inputLogMagic, sizeof(inputLogMagic)) != 0 || header.version < 1 || header.version > inputLogVersion ||
+		std::memcmp(footer.magic, inputLogMagic, sizeof(inputLogMagic)) != 0)
+		return false;
+
+	events.resize((bytes.size() - sizeof(header) - sizeof(footer)) / sizeof(InputEvent));
+	std::memcpy(events.data(), bytes.data() + sizeof(header), sizeof(InputEvent) * events.size());
+	// Inputs are applied in order, none after the end
+	for (size_t e = 0; e < events.size(); e++)
+		if ((e > 0 && events[e].step < events[e - 1].step) || events[e].step > footer.numSteps || !(events[e].stepLength > 0.0f))
+			return false;
+	if (!(header.firstStepLength > 0.0f))
+		return false;
+	firstStepLength = header.firstStepLength;
+	numSteps = footer.numSteps;
+	endHash = footer.hash;
+	return true;
+}
+
+bool InputLog::replay(Scene& scene, bool& matched) const
+{
+	matched = false;
+	SnapshotFile start;
+	if (!start.open(snapshotPathFor(path).c_str()) || !start.restore(scene))
+		return false;
+	start.close();
+
+	// Step up to each input, then apply it, as the simulation thread did
+	uint64_t done = 0;
+	float stepLength = firstStepLength;
+	for (const InputEvent& event : events)
+	{
+		if (event.step > done)
+			scene.step(stepLength, (int)(event.step - done));
+		done = event.step;
+		SimInput input;
+		input.type = (SimInput::Type)event.type;
+		input.offset = glm::vec3(event.a[0], event.a[1], event.a[2]);
+		input.integrator = (Integrator)event.integrator;
+		applyInput(scene, input);
+		// The simulation thread kept Verlet's velocities across the change
+		if (input.type == SimInput::STEP_CHANGED)
+			scene.changeStepLength(stepLength, event.stepLength);
+		stepLength = event.stepLength;
+	}
+	if (numSteps > done)
+		scene.step(stepLength, (int)(numSteps - done));
+
+	matched = hashSceneState(scene) == endHash;
+	return true;
+}
@@ -0,0 +1,96 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+// Records the input the simulation thread applies, stamped with the substep
+// it was applied before, so a run can be repeated headless and exactly.
+// Interactive runs differ because input arrives with the frame rate; the
+// recording pins it to substeps instead, so the replay does the same
+// arithmetic in the same order and ends bit for bit where the recording did.
+//
+// A recording is two files: the scene as it was when recording started, as a
+// snapshot at path + ".snp", and the log at path. The log is a header, one
+// fixed size record per input and an end record holding the substep count
+// and a hash of every cloth's state when recording stopped, which the replay
+// checks itself against. Camera moves are recorded for rendering the replay,
+// they don't touch the scene. Every change of the substep length, from
+// adaptive substeps or from switching integrator, is recorded too, so the
+// replay takes the same steps and rescales the points where we did.
+//
+// The replay has to be given a scene with the same cloths as the recorded
+// one, see demoScene.h. Threads and SIMD level don't change the results, the
+// compiler's floating point settings may.
+
+#include "scene.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct SimInput;
+
+// Version 2 added STEP_CHANGED records, version 1 logs still replay
+const uint32_t inputLogVersion = 2;
+
+// One recorded input
+struct InputEvent
+{
+	// Substeps run since recording started when it was applied
+	uint64_t step;
+	// SimInput::Type
+	uint32_t type;
+	// Substep length from this input on
+	float stepLength;
+	// Sphere offset or camera position, and camera front
+	float a[3];
+	float b[3];
+	uint32_t integrator;
+	uint32_t unused;
+};
+
+// Hash of every cloth's positions, previous positions and velocities
+uint64_t hashSceneState(const Scene& scene);
+
+// Simulation thread side
+class InputRecorder
+{
+public:
+	// Saves scene to path + ".snp" and starts the log at path. step is the
+	// caller's substep count now, stepLength the substep length in use.
+	bool start(const char* path, const Scene& scene, uint64_t step, float stepLength);
+	// Logs input if it changes the scene or the camera
+	void record(uint64_t step, const SimInput& input, float stepLength);
+	// Ends the log with the state of scene after step substeps
+	bool stop(uint64_t step, const Scene& scene);
+	bool isRecording() const { return file.is_open(); }
+	const std::string& getPath() const { return path; }
+
+private:
+	std::ofstream file;
+	std::string path;
+	uint64_t firstStep = 0;
+};
+
+class InputLog
+{
+public:
+	// Reads the log at path. The starting snapshot is only opened by replay().
+	bool open(const char* path);
+	const std::vector<InputEvent>& getEvents() const { return events; }
+	uint64_t getNumSteps() const { return numSteps; }
+	float getFirstStepLength() const { return firstStepLength; }
+
+	// Restores scene to the start of the recording and steps it through every
+	// input to the end. Returns false if the start can't be restored, and
+	// sets matched to whether scene ended as the recording did.
+	bool replay(Scene& scene, bool& matched) const;
+
+private:
+	std::string path;
+	std::vector<InputEvent> events;
+	uint64_t numSteps = 0;
+	uint64_t endHash = 0;
+	float firstStepLength = 0.0f;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "jobSystem.h"
+
+// Which pool and queue the current thread works for. Threads that are not
+// workers of a pool (the main thread) use its queue 0.
+static thread_local const JobSystem* threadPool = nullptr;
+static thread_local int threadQueue = 0;
+
+JobSystem::JobSystem(int threadCount)
+	: queued(0), quit(false)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount <= 0)
+		threadCount = 1;
+
+	for (int i = 0; i < threadCount; i++)
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	// Queue 0 belongs to whoever calls parallelFor
+	for (int i = 1; i < threadCount; i++)
+		threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+void JobSystem::parallelFor(int begin, int end, int grain, const RangeFunction& fn)
+{
+	if (grain < 1)
+		grain = 1;
+	int count = end - begin;
+	if (count <= 0)
+		return;
+	// Not worth waking anyone up
+	if (threads.empty() || count <= grain)
+	{
+		fn(begin, end);
+		return;
+	}
+
+	int numChunks = (count + grain - 1) / grain;
+	std::atomic<int> pending(numChunks);
+	int self = currentQueue();
+
+	// Deal the chunks out round robin so every thread starts with some work
+	int numQueues = (int)queues.size();
+	for (int c = 0; c < numChunks; c++)
+	{
+		Task task;
+		task.fn = &fn;
+		task.begin = begin + c * grain;
+		task.end = task.begin + grain < end ? task.begin + grain : end;
+		task.pending = &pending;
+
+		Queue& queue = *queues[(self + c) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.pushBack(task);
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		queued += numChunks;
+	}
+	wake.notify_all();
+
+	// Help out until our chunks are done, they may be running elsewhere
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		Task task;
+		if (pop(self, task) || steal(self, task))
+			run(task);
+		else
+			std::this_thread::yield();
+	}
+}
+
+int JobSystem::currentQueue() const
+{
+	return threadPool == this ? threadQueue : 0;
+}
+
+// Newest task from our own queue, it is the most likely to still be in cache
+bool JobSystem::pop(int queue, Task& task)
+{
+	Queue& q = *queues[queue];
+	std::lock_guard<std::mutex> lock(q.lock);
+	if (q.count == 0)
+		return false;
+	task = q.popBack();
+	queued--;
+	return true;
+}
+
+// Oldest task from someone else's queue
+bool JobSystem::steal(int thief, Task& task)
+{
+	int numQueues = (int)queues.size();
+	for (int i = 1; i < numQueues; i++)
+	{
+		Queue& q = *queues[(thief + i) % numQueues];
+		std::lock_guard<std::mutex> lock(q.lock);
+		if (q.count == 0)
+			continue;
+		task = q.popFront();
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::run(const Task& task)
+{
+	(*task.fn)(task.begin, task.end);
+	task.pending->fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop(int queue)
+{
+	threadPool = this;
+	threadQueue = queue;
+
+	while (true)
+	{
+		Task task;
+		if (pop(queue, task) || steal(queue, task))
+		{
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		wake.wait(lock, [this]() { return quit || queued.load() > 0; });
+		if (quit)
+			return;
+	}
+}
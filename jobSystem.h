@@ -0,0 +1,93 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+// Work-stealing thread pool. parallelFor splits a range into chunks and
+// spreads them over per-thread queues. Each thread takes work from the back
+// of its own queue and steals from the front of the others' queues when its
+// own runs dry. The calling thread works too and parallelFor only returns
+// once every chunk has run, so consecutive calls are phase barriers.
+// Nested parallelFor calls from inside a chunk are allowed.
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void(int begin, int end)> RangeFunction;
+
+class JobSystem
+{
+public:
+	// threadCount counts the calling thread, 0 means one per hardware thread
+	explicit JobSystem(int threadCount = 0);
+	~JobSystem();
+
+	int getThreadCount() const { return (int)queues.size(); }
+
+	// Calls fn on pieces of [begin, end) of at most grain items each
+	void parallelFor(int begin, int end, int grain, const RangeFunction& fn);
+
+private:
+	struct Task
+	{
+		const RangeFunction* fn;
+		int begin, end;
+		std::atomic<int>* pending;
+	};
+
+	// Ring of tasks. It doubles when full and never shrinks, so once a
+	// workload has run the queues stop allocating.
+	struct Queue
+	{
+		std::mutex lock;
+		std::vector<Task> ring;
+		size_t head = 0;
+		size_t count = 0;
+
+		void pushBack(const Task& task)
+		{
+			if (count == ring.size())
+			{
+				std::vector<Task> bigger(ring.empty() ? 64 : ring.size() * 2);
+				for (size_t i = 0; i < count; i++)
+					bigger[i] = ring[(head + i) % ring.size()];
+				ring.swap(bigger);
+				head = 0;
+			}
+			ring[(head + count) % ring.size()] = task;
+			count++;
+		}
+		Task popBack()
+		{
+			count--;
+			return ring[(head + count) % ring.size()];
+		}
+		Task popFront()
+		{
+			Task task = ring[head];
+			head = (head + 1) % ring.size();
+			count--;
+			return task;
+		}
+	};
+
+	int currentQueue() const;
+	bool pop(int queue, Task& task);
+	bool steal(int thief, Task& task);
+	void run(const Task& task);
+	void workerLoop(int queue);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	// Tasks sitting in queues, lets idle workers sleep without missing any
+	std::atomic<int> queued;
+	std::atomic<bool> quit;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+};
+
+#endif
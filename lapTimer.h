@@ -0,0 +1,26 @@
+#ifndef LAP_TIMER_H
+#define LAP_TIMER_H
+
+// Cheap wall clock stopwatch for timing the phases of a frame or step
+
+#include <chrono>
+
+class LapTimer
+{
+public:
+	LapTimer() : last(std::chrono::steady_clock::now()) {}
+
+	// Seconds since construction or the previous lap
+	double lap()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(now - last).count();
+		last = now;
+		return seconds;
+	}
+
+private:
+	std::chrono::steady_clock::time_point last;
+};
+
+#endif
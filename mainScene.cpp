@@ -5,10 +5,22 @@
 #include <GLFW/glfw3.h>
 // shader helper
 #include "shader.h"
+// cloth simulation
+#include "demoScene.h"
+#include "scene.h"
+#include "snapshot.h"
+#include "simThread.h"
+#include "vertexStream.h"
+// performance counters
+#include "lapTimer.h"
+#include "metrics.h"
 // math
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+// containers
+#include <memory>
+#include <vector>
 // image loading
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
@@ -37,43 +49,13 @@ float lastX = SCR_WIDTH / 2.0f, lastY = SCR_HEIGHT / 2.0f;
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
-// cloth
-struct ClothPoint {
-	glm::vec3 pos, vel, forces, norm, prevPos;
-	glm::vec2 uv;
-};
-const int columns = 30;
-const int rows = 30;
-const int numPoints = rows * columns;
-ClothPoint points[numPoints];
-
-struct Spring {
-	ClothPoint* point1;
-	ClothPoint* point2;
-	float restLen, k, vK;
-};
-//const int numSprings = (rows) * (columns-1);
-const int numSprings = (rows) * (columns - 1) + (rows - 1) * (columns);// +(rows) * (columns) * 4;
-Spring springs[numSprings];
-
-// cloth physics
-float clothK = 4.00f;
-float dampK = 0.09f;
-float crossClothK = 9.0f;
-float crossDampK = 0.2f;
-float clothMass = 0.244f / numPoints; //Actual mass of flag in kg/m2
-float airDensity = 1.0f; // Actual density is 1.225 kg/m3 apparently
-float clothDragCoef = 0.01f;
-
-
-float timeInterval = 0.001;
-glm::vec3 grav = glm::vec3(0.0f, -9.8f, 0.0f);
-
-bool eularianIntegration = false;
-
-// Sphere
-const float sphereR = 2.0f;
-glm::vec3 spherePos = glm::vec3(3.0f, sphereR, -3.0f);
+// cloths, set up in main and stepped on their own thread
+std::unique_ptr<Scene> scene;
+// F5 saves the scene here, and the next run starts from it
+const char* snapshotPath = "scene.snp";
+// F6 starts and stops recording input here, replay it with clothHeadless --replay
+const char* recordingPath = "input.rec";
+SimThread* simThread = nullptr;
 
 int main()
 {
@@ -105,153 +87,60 @@ int main()
 	// Setup ----------------------------------
 
 	// Cloth data
-		// initialize points
-	for (int i = 0; i < rows; i++)
+	scene.reset(new Scene());
+	bool sceneReady = buildDemoScene(*scene);
+	if (!sceneReady)
 	{
-		for (int j = 0; j < columns; j++)
-		{
-			// Inital cloth points
-			float scale = 4.0f;
-			//points[i * columns + j].pos = glm::vec3(3.0f + scale * 1.92f * ((float)i / rows), 6.0f - scale * 1.220f * ((float)j / columns), 3.0f);
-			points[i * columns + j].pos = glm::vec3(3.0f + scale * 1.92f * ((float)i / rows), 6.0f, 3.0f - scale * 1.220f * ((float)j / columns));
-			points[i * columns + j].prevPos = points[i * columns + j].pos;
-			points[i * columns + j].vel = glm::vec3(0.0f);
-			points[i * columns + j].forces = glm::vec3(0.0f);
-			points[i * columns + j].uv = glm::vec2(i / (float)rows, j / (float)columns);
-			points[i * columns + j].norm = glm::vec3(0.0f, 0.0f, 1.0f);
-		}
-	}
-		// initialize springs
-	for (int i = 0; i < rows; i++)
-	{
-		for (int j = 0; j < columns; j++)
-		{
-			// Horizontal springs - there are (rows) * (columns-1) of these
-			if (j < columns - 1)
-			{
-				Spring &s = springs[i * (columns - 1) + j];
-				//std::cout << i * (columns - 1) + j << std::endl;
-				s.point1 = &points[i * columns + j];
-				s.point2 = &points[(i + 0) * columns + (j + 1)];
-				s.restLen = glm::length(s.point1->pos - s.point2->pos);
-				s.k = clothK;
-				s.vK = dampK;
-			}
-
-			// Verticle springs - there are (rows-1) * (column) of these
-			if (i < rows - 1)
-			{
-				Spring &s = springs[(rows) * (columns - 1) + i * columns + j];
-				//std::cout << (rows) * (columns - 1) + i * columns + j << std::endl;
-				s.point1 = &points[i * columns + j];
-				s.point2 = &points[(i + 1) * columns + j];
-				s.restLen = glm::length(s.point1->pos - s.point2->pos);
-				s.k = clothK;
-				s.vK = dampK;
-			}
-
-			// Cross springs
-			/*
-			if (i < rows - 2)// all but last 2 rows
-			{
-				if (i % 2 == 0 && j % 2 == 0) // every other point
-				{
-					Spring&s = springs[(rows) * (columns - 1) + (rows - 1) * (columns)+i * columns + j];
-					if (j%columns - 2 >= 0) // down left spring - only if you can move two to your left
-					{
-						std::cout << (rows) * (columns - 1) + (rows - 1) * (columns)+i * columns + j << std::endl;
-						s.point1 = &points[i * columns + j];
-						s.point2 = &points[(i - 2) * columns + j + 2];
-						s.restLen = glm::length(s.point1->pos - s.point2->pos);
-						s.k = crossClothK;
-						s.vK = crossDampK;
-					}
-					if (j % columns + 2 <= columns) // down right spring - only if you can move two to the right
-					{
-						std::cout << (rows) * (columns - 1) + (rows - 1) * (columns)+i * columns + j << std::endl;
-						s.point1 = &points[i * columns + j];
-						s.point2 = &points[(i + 2) * columns + j + 2];
-						s.restLen = glm::length(s.point1->pos - s.point2->pos);
-						s.k = crossClothK;
-						s.vK = crossDampK;
-					}
-				}
-			}
-			//*/
-		}
-	}
-	// Cross springs
-	for (int i = 0; i < rows/2; i++)
-	{
-		for (int j = 0; j < columns/2; j++)
-		{
-			// There are (rows) * (columns - 1) + (rows - 1) * (columns) spings already
-			// Spring&s = springs[(rows) * (columns - 1) + (rows - 1) * (columns) + (columns / 2) * i + j];
-			//std::cout << (rows) * (columns - 1) + (rows - 1) * (columns)+(columns / 2) * i + j << std::endl;
-
-
-		}
+		std::cout << "Failed to set up cloth" << std::endl;
+		glfwTerminate();
+		return -1;
 	}
-
-	// Set up indices for rendering
-	const int numFaces = (rows - 1) * (columns - 1) * 2;
-	unsigned int clothIndices[numFaces * 3];
-	for (int i = 0; i < rows-1; i++)
+	// Start from the last saved drape if there is one
+	SnapshotFile savedScene;
+	if (savedScene.open(snapshotPath))
 	{
-		for (int j = 0; j < columns-1; j++)
-		{
-			// Wind counter-clockwise
-			int index = (i * (columns-1) + j) * 6;
-
-			clothIndices[index] = (i) * columns + (j);
-			clothIndices[index+1] = (i+1) * columns + (j);
-			clothIndices[index+2] = (i+1) * columns + (j+1);
-
-			clothIndices[index+3] = (i)* columns + (j);
-			clothIndices[index+4] = (i+1)* columns + (j+1);
-			clothIndices[index+5] = (i)* columns + (j+1);
-		}
+		if (savedScene.restore(*scene))
+			std::cout << "Loaded " << snapshotPath << std::endl;
+		else
+			std::cout << snapshotPath << " is of a different scene, starting flat" << std::endl;
+		savedScene.close();
 	}
+	const int numPoints = scene->getNumPoints();
+	const int numFaces = scene->getNumFaces();
+	const unsigned int* clothIndices = scene->getIndices();
+	const float sphereR = scene->getSphereR();
 
 	// Cloth rendering
+	// Every cloth shares one vertex buffer, one index buffer and one draw
 	Shader clothShader("cloth.vert", "cloth.frag");
-	glm::vec3 clothVertices[numPoints];
-	for (int i = 0; i < numPoints; i++)
-	{
-		clothVertices[i] = points[i].pos;
-	}
-	glm::vec2 clothUVs[numPoints];
-	for (int i = 0; i < numPoints; i++)
-	{
-		clothUVs[i] = points[i].uv;
-	}
-	glm::vec3 clothNormals[numPoints];
-	for (int i = 0; i < numPoints; i++)
+	std::vector<glm::vec2> clothUVs(numPoints);
+	for (int c = 0; c < scene->getNumCloths(); c++)
 	{
-		clothNormals[i] = points[i].norm;
+		const Cloth& cloth = scene->getCloth(c);
+		const ParticleArrays& particles = cloth.getParticles();
+		for (int i = 0; i < cloth.getNumPoints(); i++)
+		{
+			clothUVs[scene->getFirstPoint(c) + i] = particles.uv(i);
+		}
 	}
 	unsigned int clothVAO;
 	glGenVertexArrays(1, &clothVAO);
 	glBindVertexArray(clothVAO);
 
-	unsigned int clothPosBuffer;
-	glGenBuffers(1, &clothPosBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, clothPosBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(clothVertices), clothVertices, GL_STREAM_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-	glEnableVertexAttribArray(0);
-
-	unsigned int clothNormBuffer;
-	glGenBuffers(1, &clothNormBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, clothNormBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(clothNormals), clothNormals, GL_STREAM_DRAW);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-	glEnableVertexAttribArray(1);
+	// Positions and normals change every frame, the cloth writes them straight
+	// into the stream's buffer
+	VertexStream clothStream;
+	if (!clothStream.init(numPoints, (GLADloadproc)glfwGetProcAddress, 0, 1))
+	{
+		std::cout << "Failed to set up the cloth vertex buffer" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
 
 	unsigned int clothUVBuffer;
 	glGenBuffers(1, &clothUVBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, clothUVBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(clothUVs), clothUVs, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * numPoints, clothUVs.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
 	glEnableVertexAttribArray(2);
 
@@ -259,7 +148,7 @@ int main()
 	unsigned int clothElementBuffer;
 	glGenBuffers(1, &clothElementBuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clothElementBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(clothIndices), clothIndices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * numFaces * 3, clothIndices, GL_STATIC_DRAW);
 
 	// Flag texture
 	// Set up textures
@@ -389,6 +278,24 @@ int main()
 	// uncomment this call to draw in wireframe polygons.
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+	// Performance summary once a second, off the render thread. Pass a file
+	// name after the interval to also log every frame as CSV.
+	Metrics metrics(1.0f);
+
+	// From here on only the simulation thread touches the cloths
+	SimThread sim(*scene);
+	simThread = &sim;
+	// Substeps as long as the cloth allows, F7 goes back to fixed ones
+	SimInput adaptiveInput;
+	adaptiveInput.type = SimInput::SET_ADAPTIVE;
+	adaptiveInput.adaptive = true;
+	sim.send(adaptiveInput);
+	sim.start();
+	StepTimes lastStepTimes = sim.latest().stepTimes;
+	const int numSprings = scene->getNumSprings();
+	const size_t renderMemory = clothStream.getMemoryUsed() + sim.getMemoryUsed()
+		+ clothUVs.size() * sizeof(glm::vec2) * 2 + sizeof(unsigned int) * numFaces * 3; // UVs and indices, CPU and GPU
+
 	// render loop ----------------------------
 	while (!glfwWindowShouldClose(window))
 	{
@@ -396,131 +303,32 @@ int main()
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
-		std::cout << 1.0f/deltaTime << std::endl;
-		if (timeInterval != 0.0f)
-			deltaTime = timeInterval;
+		FrameSample sample;
+		sample.frameTime = deltaTime;
 
 		// input
 		processInput(window);
 
 		// processing
-		// Process for each spring
-			for (int i = 0; i < numSprings; i++)
-			{
-				// Apply a force to both points you are connected to
-				Spring &s = springs[i];
-				glm::vec3 displacement = s.point1->pos - s.point2->pos;
-				glm::vec3 dir = glm::normalize(displacement);
-				float len = glm::length(displacement);
-				float sForce = (s.restLen - len) * clothK;
-				s.point1->forces += sForce * dir;
-				s.point2->forces -= sForce * dir;
-				// Dampen velocities
-				float v1 = glm::dot(s.point1->vel, dir);
-				float v2 = glm::dot(s.point2->vel, dir);
-				glm::vec3 dForce = dir * dampK * (v1 - v2);
-				s.point1->forces -= dForce;
-				s.point2->forces += dForce;
-				
-				/* // Old method
-				glm::vec3 dForce2 = dampK / 1000.0f * (s.point1->vel - s.point2->vel);
-				s.point1->forces -= dForce2;
-				s.point2->forces += dForce2;
-				//*/
-			}
-		// Process each face
-			for (int i = 0; i < numFaces; i += 1)
-			{
-				// Get points for each point on face
-				ClothPoint &p1 = points[clothIndices[i * 3]];
-				ClothPoint &p2 = points[clothIndices[i * 3 + 1]];
-				ClothPoint &p3 = points[clothIndices[i * 3 + 2]];
-				// Drag
-				// f = -1/2p*length(v)*DragCoef*area*normal
-				glm::vec3 airVel = glm::vec3(0.0f, 0.0f, 0.001f);
-				// v is velocity of face - velocity of the air
-				glm::vec3 v = (p1.vel + p2.vel + p3.vel) / 3.0f + airVel;
-				// use cross product and normalize to get n
-				glm::vec3 cross = glm::cross((p1.pos - p2.pos), (p1.pos - p3.pos)); //Pull this out to reuse
-				glm::vec3 n = glm::normalize(cross);
-				// area of face is half of the area of parallelogram, dot this with velocity to get area exposed to flow
-				float a = glm::dot((0.5f * cross), glm::normalize(v));
-				// put all together to get drag
-				glm::vec3 dragForce = -0.5f * airDensity * glm::length(v) * clothDragCoef * a * n;
-				// Give each point on face 1/3 of force
-				bool drag = true;
-				if (drag)
-				{	
-					p1.forces += dragForce / 3.0f;
-					p2.forces += dragForce / 3.0f;
-					p3.forces += dragForce / 3.0f;
-				}
-			p1.norm += n;
-			p2.norm += n;
-			p3.norm += n;
-		}
-		// Process each non-fixed point
-		for (int i = 0; i < numPoints; i++)
-		{
-			ClothPoint &p = points[i];
-			if (i % columns != 0)
-			{
-				// Gravity
-				p.forces += grav * clothMass;
-				//p.forces -= 0.0001f * p.vel;
-
-				// Now integrate forces
-				glm::vec3 accel = p.forces / clothMass;
-				// Integrate velocity
-				if (eularianIntegration)
-				{
-					p.pos += p.vel * deltaTime;
-					p.vel += accel * deltaTime;
-				}
-				else
-				{
-					p.vel += accel * deltaTime;
-					glm::vec3 temp = p.prevPos;
-					p.prevPos = p.pos;
-					p.pos = 2.0f * p.pos - temp + accel * deltaTime*deltaTime;
-				}
-
-				// Collisions
-				if (p.pos[1] < 0.01f)
-				{
-					p.pos[1] = 0.01f;
-					p.vel[1] *= -0.95;
-				}
-				glm::vec3 off = (p.pos - spherePos);
-				float buffer = 0.03f;
-				if (glm::length(off) < (sphereR + buffer))
-				{
-					p.pos = spherePos + normalize(off)*(sphereR + buffer);
-					p.vel = glm::reflect(p.vel, normalize(off));
-				}
-
-				p.forces = glm::vec3(0.0f);
-
-			}
-
-			// Calculate normals
-			// normal should have been added from each face, so we just normalize
-			p.norm += glm::vec3(0.0f, 0.0f, 0.01f);
-			p.norm = p.norm / glm::length(p.norm);
-			//std::cout << glm::length(p.norm) << std::endl;
-			
-		}
-
-		for (int i = 0; i < numPoints; i++)
-		{
-			clothVertices[i] = points[i].pos;
-			clothNormals[i] = points[i].norm;
-		}
-		glBindBuffer(GL_ARRAY_BUFFER, clothPosBuffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(clothVertices), clothVertices, GL_STREAM_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, clothNormBuffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(clothNormals), clothNormals, GL_STREAM_DRAW);
-
+		// Newest state from the simulation thread, and how much it stepped since the last one
+		const ClothSnapshot& snapshot = sim.latest();
+		const StepTimes& stepTimes = snapshot.stepTimes;
+		sample.phaseTime[PHASE_SPRINGS] = (float)(stepTimes.springs - lastStepTimes.springs);
+		sample.phaseTime[PHASE_FACES] = (float)(stepTimes.faces - lastStepTimes.faces);
+		sample.phaseTime[PHASE_POINTS] = (float)(stepTimes.points - lastStepTimes.points);
+		sample.substeps = stepTimes.steps - lastStepTimes.steps;
+		sample.numPoints = numPoints;
+		sample.numSprings = numSprings;
+		lastStepTimes = stepTimes;
+		LapTimer renderTimer;
+
+		// Draw the cloths where they are between the last two physics states,
+		// one substep behind the simulation
+		float alpha = (float)((SimThread::now() - snapshot.time) / snapshot.step);
+		snapshot.blend(alpha < 1.0f ? alpha : 1.0f, clothStream.begin());
+		glBindVertexArray(clothVAO);
+		clothStream.end();
+		sample.phaseTime[PHASE_UPLOAD] = (float)renderTimer.lap();
 
 		// rendering commands here
 		glClearColor(0.2f, 0.4f, 0.4f, 1.0f);
@@ -552,14 +360,15 @@ int main()
 
 		texturedShader.setInt("material.diffuse", 1);
 		glBindVertexArray(clothVAO);
-		glDrawElements(GL_TRIANGLES, (rows - 1) * (columns - 1) * 6, GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, numFaces * 3, GL_UNSIGNED_INT, 0);
+		clothStream.fence();
 		
 		clothShader.use();
 		clothShader.setVec4("col", glm::vec4(0.9f, 0.8f, 0.6f, 1.0f));
 		clothShader.setMat4("view", view);
 		clothShader.setMat4("projection", projection);
 
-		model = glm::translate(model, spherePos);
+		model = glm::translate(model, snapshot.spherePos);
 		model = glm::scale(model, glm::vec3(sphereR));
 		clothShader.setMat4("model", model);
 		glBindVertexArray(sphereVAO);
@@ -567,12 +376,22 @@ int main()
 
 		model = glm::mat4(1.0f);
 		clothShader.setMat4("model", model);
+		// Time to submit the draws, the GPU may still be working on them
+		sample.phaseTime[PHASE_DRAW] = (float)renderTimer.lap();
+
+		sample.memory[MEMORY_CLOTH] = snapshot.clothMemory;
+		sample.memory[MEMORY_RENDER] = renderMemory;
+		sample.memory[MEMORY_METRICS] = metrics.getMemoryUsed();
+		metrics.record(sample);
 
 		// check and call events and swap the buffers
 		glfwPollEvents();
 		glfwSwapBuffers(window);
 	}
 
+	sim.stop();
+	simThread = nullptr;
+	clothStream.release();
 	glfwTerminate();
 
 	//while (true) {} // Uncomment to see output after you close window
@@ -606,16 +425,89 @@ void processInput(GLFWwindow *window)
 	if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
 		cameraPos -= cameraSpeed * cameraUp;
 
+	// The sphere and the integrator belong to the simulation thread, changes
+	// are sent to it
 	float sphereSpeed = 2.0f * deltaTime;
+	SimInput input;
+	input.type = SimInput::MOVE_SPHERE;
+	input.offset = glm::vec3(0.0f);
 	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-		spherePos[0] += sphereSpeed;
+		input.offset[0] += sphereSpeed;
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-		spherePos[0] -= sphereSpeed;
+		input.offset[0] -= sphereSpeed;
 	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		spherePos[2] += sphereSpeed;
+		input.offset[2] += sphereSpeed;
 	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		spherePos[2] -= sphereSpeed;
+		input.offset[2] -= sphereSpeed;
+	if (input.offset != glm::vec3(0.0f))
+		simThread->send(input);
+
+	// 1 - 4 pick Verlet, Euler, implicit or XPBD, once per press
+	const int integratorKeys[] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4 };
+	const Integrator integrators[] = { INTEGRATOR_VERLET, INTEGRATOR_EULER, INTEGRATOR_IMPLICIT, INTEGRATOR_XPBD };
+	static bool integratorPressed[4] = {};
+	for (int i = 0; i < 4; i++)
+	{
+		bool pick = glfwGetKey(window, integratorKeys[i]) == GLFW_PRESS;
+		if (pick && !integratorPressed[i])
+		{
+			input.type = SimInput::SET_INTEGRATOR;
+			input.integrator = integrators[i];
+			simThread->send(input);
+		}
+		integratorPressed[i] = pick;
+	}
 
+	// F5 saves the scene, once per press
+	static bool savePressed = false;
+	bool save = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+	if (save && !savePressed)
+	{
+		input.type = SimInput::SAVE_SNAPSHOT;
+		input.path = snapshotPath;
+		simThread->send(input);
+	}
+	savePressed = save;
+
+	// F6 starts recording, pressed again stops it
+	static bool recordPressed = false;
+	static bool recording = false;
+	bool record = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+	if (record && !recordPressed)
+	{
+		input.type = recording ? SimInput::STOP_RECORDING : SimInput::START_RECORDING;
+		input.path = recordingPath;
+		if (simThread->send(input))
+			recording = !recording;
+	}
+	recordPressed = record;
+
+	// F7 switches between adaptive and fixed substeps
+	static bool adaptivePressed = false;
+	static bool adaptive = true;
+	bool toggle = glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS;
+	if (toggle && !adaptivePressed)
+	{
+		input.type = SimInput::SET_ADAPTIVE;
+		input.adaptive = !adaptive;
+		if (simThread->send(input))
+			adaptive = !adaptive;
+	}
+	adaptivePressed = toggle;
+
+	// The camera goes to the simulation thread only to be recorded
+	static glm::vec3 sentPos(0.0f), sentFront(0.0f);
+	if (cameraPos != sentPos || cameraFront != sentFront)
+	{
+		input.type = SimInput::SET_CAMERA;
+		input.cameraPos = cameraPos;
+		input.cameraFront = cameraFront;
+		if (simThread->send(input))
+		{
+			sentPos = cameraPos;
+			sentFront = cameraFront;
+		}
+	}
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
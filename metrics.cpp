@@ -0,0 +1,126 @@
+#include "metrics.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static const char* phaseNames[numPhases] = { "springs", "faces", "points", "upload", "draw" };
+static const char* memoryNames[numMemories] = { "cloth", "render", "metrics" };
+
+Metrics::Metrics(float summaryInterval, const std::string& csvPath)
+	: dropped(0), quit(false), summaryInterval(summaryInterval)
+{
+	clearTotals();
+	for (int m = 0; m < numMemories; m++)
+		memory[m] = 0;
+	if (!csvPath.empty())
+	{
+		csv.open(csvPath.c_str());
+		if (csv)
+		{
+			csv << "frameTime";
+			for (int p = 0; p < numPhases; p++)
+				csv << "," << phaseNames[p] << "Time";
+			csv << ",substeps,numPoints,numSprings";
+			for (int m = 0; m < numMemories; m++)
+				csv << "," << memoryNames[m] << "Bytes";
+			csv << "\n";
+		}
+		else
+			std::cout << "Failed to open " << csvPath << " for metrics" << std::endl;
+	}
+	writer = std::thread(&Metrics::writerLoop, this);
+}
+
+Metrics::~Metrics()
+{
+	quit.store(true, std::memory_order_release);
+	writer.join();
+}
+
+void Metrics::record(const FrameSample& sample)
+{
+	if (!ring.push(sample))
+		dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::writerLoop()
+{
+	while (true)
+	{
+		// Read quit first so nothing pushed before it was set is missed
+		bool stopping = quit.load(std::memory_order_acquire);
+		FrameSample sample;
+		while (ring.pop(sample))
+			add(sample);
+		if (stopping)
+			break;
+		// A frame's worth of samples at most piles up meanwhile
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	if (frames > 0)
+		printSummary();
+}
+
+void Metrics::add(const FrameSample& sample)
+{
+	if (csv)
+	{
+		csv << sample.frameTime;
+		for (int p = 0; p < numPhases; p++)
+			csv << "," << sample.phaseTime[p];
+		csv << "," << sample.substeps << "," << sample.numPoints << "," << sample.numSprings;
+		for (int m = 0; m < numMemories; m++)
+			csv << "," << sample.memory[m];
+		csv << "\n";
+	}
+
+	frames++;
+	frameTime += sample.frameTime;
+	for (int p = 0; p < numPhases; p++)
+		phaseTime[p] += sample.phaseTime[p];
+	substeps += sample.substeps;
+	pointSteps += (double)sample.numPoints * sample.substeps;
+	springSteps += (double)sample.numSprings * sample.substeps;
+	for (int m = 0; m < numMemories; m++)
+		memory[m] = sample.memory[m];
+
+	if (frameTime >= summaryInterval)
+		printSummary();
+}
+
+// One line per interval, times are averages per frame
+void Metrics::printSummary()
+{
+	double seconds = frameTime > 0.0 ? frameTime : 1.0;
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1) << "fps " << frames / seconds << " |";
+	line << std::setprecision(3);
+	for (int p = 0; p < numPhases; p++)
+		line << " " << phaseNames[p] << " " << 1000.0 * phaseTime[p] / frames << "ms";
+	line << " |" << std::setprecision(2)
+		<< " springs/s " << springSteps / seconds / 1e6 << "M"
+		<< " particles/s " << pointSteps / seconds / 1e6 << "M"
+		<< std::setprecision(0) << " substeps/s " << substeps / seconds << " |";
+	line << std::setprecision(2);
+	for (int m = 0; m < numMemories; m++)
+		line << " " << memoryNames[m] << " " << memory[m] / (1024.0 * 1024.0) << "MB";
+	int lost = dropped.exchange(0, std::memory_order_relaxed);
+	if (lost > 0)
+		line << " | dropped " << lost;
+	std::cout << line.str() << std::endl;
+
+	clearTotals();
+}
+
+void Metrics::clearTotals()
+{
+	frames = 0;
+	frameTime = 0.0;
+	for (int p = 0; p < numPhases; p++)
+		phaseTime[p] = 0.0;
+	substeps = 0.0;
+	pointSteps = 0.0;
+	springSteps = 0.0;
+}
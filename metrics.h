@@ -0,0 +1,92 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// Runtime performance counters. The render loop fills in one FrameSample per
+// frame and hands it over with record(), which only copies it into a lock
+// free ring. A writer thread drains the ring and every summaryInterval
+// seconds of frames prints one summary line: time per phase, throughput and
+// memory in use. It can also write every frame as a CSV row. Nothing is
+// printed or flushed on the render thread.
+
+#include "spscRing.h"
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+
+enum MetricPhase
+{
+	PHASE_SPRINGS,
+	PHASE_FACES,
+	PHASE_POINTS,
+	PHASE_UPLOAD,
+	PHASE_DRAW,
+	numPhases
+};
+
+enum MetricMemory
+{
+	MEMORY_CLOTH,
+	MEMORY_RENDER,
+	MEMORY_METRICS,
+	numMemories
+};
+
+struct FrameSample
+{
+	// Wall clock seconds for the whole frame and for each phase of it
+	float frameTime = 0.0f;
+	float phaseTime[numPhases] = {};
+	// Work done by the simulation this frame
+	int substeps = 0;
+	int numPoints = 0;
+	int numSprings = 0;
+	// Bytes in use per subsystem
+	size_t memory[numMemories] = {};
+};
+
+class Metrics
+{
+public:
+	// Prints a summary every summaryInterval seconds of recorded frames, and
+	// writes every frame to csvPath unless it is empty
+	explicit Metrics(float summaryInterval = 1.0f, const std::string& csvPath = std::string());
+	~Metrics();
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	// Hands a frame to the writer thread, never blocks. If the writer has
+	// fallen behind the frame is dropped and counted instead.
+	void record(const FrameSample& sample);
+
+	// Frames dropped since the last summary
+	int getDropped() const { return dropped.load(std::memory_order_relaxed); }
+	size_t getMemoryUsed() const { return sizeof(*this); }
+
+private:
+	void writerLoop();
+	void add(const FrameSample& sample);
+	void printSummary();
+	void clearTotals();
+
+	static const int ringSize = 1024;
+	SpscRing<FrameSample, ringSize> ring;
+	std::atomic<int> dropped;
+	std::atomic<bool> quit;
+
+	// Writer thread only
+	float summaryInterval;
+	std::ofstream csv;
+	int frames;
+	double frameTime;
+	double phaseTime[numPhases];
+	// Substeps run, and points and springs updated over all of them
+	double substeps, pointSteps, springSteps;
+	size_t memory[numMemories];
+
+	std::thread writer;
+};
+
+#endif
@@ -0,0 +1,557 @@
+#include "multiresCloth.h"
+
+#include "clothPhysics.h"
+#include "clothTopology.h"
+#include "lapTimer.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Catmull-Rom taps and weights of every one of numFine fine rows (or
+// columns) over numCoarse coarse ones, coarse row I being fine row nodes[I]
+static void buildTaps(int numFine, int step, int numCoarse, const int* nodes, int* taps, float* weights)
+{
+	for (int r = 0; r < numFine; r++)
+	{
+		int I = std::min(r / step, numCoarse - 2);
+		float t = (float)(r - nodes[I]) / (nodes[I + 1] - nodes[I]);
+		float t2 = t * t, t3 = t2 * t;
+		int* tap = taps + r * 4;
+		float* w = weights + r * 4;
+		tap[0] = I - 1;
+		tap[1] = I;
+		tap[2] = I + 1;
+		tap[3] = I + 2;
+		w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+		w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+		w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+		w[3] = 0.5f * (t3 - t2);
+		// Past either end the grid carries on in a straight line, 2 * end - next
+		if (I == 0)
+		{
+			w[1] += 2.0f * w[0];
+			w[2] -= w[0];
+			w[0] = 0.0f;
+			tap[0] = 0;
+		}
+		if (I + 2 >= numCoarse)
+		{
+			w[2] += 2.0f * w[3];
+			w[1] -= w[3];
+			w[3] = 0.0f;
+			tap[3] = numCoarse - 1;
+		}
+	}
+}
+
+// Coarse row (or column) nearest fine row r
+static int nearestNode(int r, int step, int numCoarse, const int* nodes)
+{
+	int I = std::min(r / step, numCoarse - 2);
+	return r - nodes[I] <= nodes[I + 1] - r ? I : I + 1;
+}
+
+bool MultiresCloth::init(const ClothParams& clothParams)
+{
+	if (clothParams.rows < 2 || clothParams.columns < 2 ||
+		clothParams.rows > maxGridSize || clothParams.columns > maxGridSize)
+		return false;
+	for (int pin : clothParams.pins)
+		if (pin < 0 || pin >= clothParams.rows * clothParams.columns)
+			return false;
+
+	params = clothParams;
+	rows = params.rows;
+	columns = params.columns;
+	numPoints = rows * columns;
+	numSprings = countSprings(params, rows, columns);
+	numFaces = (rows - 1) * (columns - 1) * 2;
+
+	// Size everything, then allocate it in one go
+	Arena sizing;
+	layout(sizing);
+	if (!arena.reserve(sizing.getUsed()))
+		return false;
+	layout(arena);
+
+	if (params.jobs)
+		jobs = params.jobs;
+	else
+	{
+		if (!ownJobs || (params.threads > 0 && params.threads != ownJobs->getThreadCount()))
+			ownJobs.reset(new JobSystem(params.threads));
+		jobs = ownJobs.get();
+	}
+	stepTimes = StepTimes();
+	refineTime = 0.0;
+	velocitiesBehind = false;
+
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < columns; j++)
+		{
+			int index = i * columns + j;
+			particles.setPos(index, flatPosition(params, rows, columns, i, j));
+			particles.setPrevPos(index, particles.pos(index));
+			particles.setVel(index, glm::vec3(0.0f));
+			particles.setForce(index, glm::vec3(0.0f));
+			particles.u[index] = i / (float)rows;
+			particles.v[index] = j / (float)columns;
+			particles.setNorm(index, glm::vec3(0.0f, 0.0f, 1.0f));
+		}
+	}
+	// Hold the pins still, the pole by default
+	for (int i = 0; i < numPoints; i++)
+		pinned[i] = params.pins.empty() && i % columns == 0;
+	for (int pin : params.pins)
+		pinned[pin] = 1;
+
+	buildSprings(params, rows, columns, springs);
+	springsColored = colorSprings(springs, numSprings, numPoints, numSpringColors, springColorStart);
+
+	// Same faces as ClothSolver
+	for (int i = 0; i < rows - 1; i++)
+	{
+		for (int j = 0; j < columns - 1; j++)
+		{
+			int index = (i * (columns - 1) + j) * 6;
+			clothIndices[index] = i * columns + j;
+			clothIndices[index + 1] = (i + 1) * columns + j;
+			clothIndices[index + 2] = (i + 1) * columns + j + 1;
+			clothIndices[index + 3] = i * columns + j;
+			clothIndices[index + 4] = (i + 1) * columns + j + 1;
+			clothIndices[index + 5] = i * columns + j + 1;
+		}
+	}
+	return setLevel(params.multiresLevel);
+}
+
+void MultiresCloth::layout(Arena& memory)
+{
+	for (int f = 0; f < numParticleFields; f++)
+		particles.*particleFields<float>[f] = memory.alloc<float>(numPoints);
+
+	// Only the ends and rest lengths are used, buildSprings fills in k and vK too
+	springs = SpringArrays();
+	springs.point1 = memory.alloc<uint32_t>(numSprings);
+	springs.point2 = memory.alloc<uint32_t>(numSprings);
+	springs.restLen = memory.alloc<float>(numSprings);
+	springs.k = memory.alloc<float>(numSprings);
+	springs.vK = memory.alloc<float>(numSprings);
+
+	clothIndices = memory.alloc<unsigned int>(numFaces * 3);
+	pinned = memory.alloc<uint8_t>(numPoints);
+	held = memory.alloc<uint8_t>(numPoints);
+	baseX = memory.alloc<float>(numPoints);
+	baseY = memory.alloc<float>(numPoints);
+	baseZ = memory.alloc<float>(numPoints);
+	// Coarse rows are never more than fine ones
+	for (int k = 0; k < 3; k++)
+		across[k] = memory.alloc<float>(numPoints);
+	rowTaps = memory.alloc<int>(rows * 4);
+	rowWeights = memory.alloc<float>(rows * 4);
+	columnTaps = memory.alloc<int>(columns * 4);
+	columnWeights = memory.alloc<float>(columns * 4);
+	nodeRow = memory.alloc<int>(rows);
+	nodeColumn = memory.alloc<int>(columns);
+	faceNormX = memory.alloc<float>(numFaces);
+	faceNormY = memory.alloc<float>(numFaces);
+	faceNormZ = memory.alloc<float>(numFaces);
+}
+
+bool MultiresCloth::setLevel(int newLevel)
+{
+	// The new coarse cloth starts from the fine velocities, prolonged from
+	// the old one while its taps are still set up
+	catchUpVelocities();
+
+	// Past a 2 x 2 coarse grid a level is no coarser
+	level = std::min(std::max(newLevel, 0), 12);
+	while (level > 0 && (1 << (level - 1)) >= std::max(rows, columns) - 1)
+		level--;
+	params.multiresLevel = level;
+
+	int step = 1 << level;
+	numNodeRows = (rows - 2) / step + 2;
+	numNodeColumns = (columns - 2) / step + 2;
+	for (int I = 0; I < numNodeRows; I++)
+		nodeRow[I] = std::min(I * step, rows - 1);
+	for (int J = 0; J < numNodeColumns; J++)
+		nodeColumn[J] = std::min(J * step, columns - 1);
+	buildTaps(rows, step, numNodeRows, nodeRow, rowTaps, rowWeights);
+	buildTaps(columns, step, numNodeColumns, nodeColumn, columnTaps, columnWeights);
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < columns; j++)
+		{
+			bool node = (i % step == 0 || i == rows - 1) && (j % step == 0 || j == columns - 1);
+			held[i * columns + j] = pinned[i * columns + j] || node;
+		}
+	}
+
+	// Each pin holds the coarse point nearest it, no pins is the pole either way
+	coarsePins.clear();
+	for (int pin : params.pins)
+	{
+		int I = nearestNode(pin / columns, step, numNodeRows, nodeRow);
+		int J = nearestNode(pin % columns, step, numNodeColumns, nodeColumn);
+		coarsePins.push_back(I * numNodeColumns + J);
+	}
+	ClothParams coarseParams = params;
+	coarseParams.rows = numNodeRows;
+	coarseParams.columns = numNodeColumns;
+	coarseParams.pins = coarsePins;
+	coarseParams.jobs = jobs;
+	if (!coarse.init(coarseParams))
+		return false;
+	// Rest lengths from the flat layout, then carry on from where the points are
+	return restrictToCoarse(true) && restrictToCoarse(false);
+}
+
+int MultiresCloth::levelForScreenSize(const ClothParams& params, float pixels, float pixelsPerPoint)
+{
+	float spacing = pixels / (std::max(params.rows, params.columns) - 1);
+	int level = 0;
+	while (level < 12 && spacing * (2 << level) <= pixelsPerPoint)
+		level++;
+	return level;
+}
+
+bool MultiresCloth::restrictToCoarse(bool restShape)
+{
+	int numNodes = numNodeRows * numNodeColumns;
+	ParticleArrays nodes;
+	Arena sizing, memory;
+	for (int f = 0; f < numParticleFields; f++)
+		sizing.alloc<float>(numNodes);
+	if (!memory.reserve(sizing.getUsed()))
+		return false;
+	for (int f = 0; f < numParticleFields; f++)
+		nodes.*particleFields<float>[f] = memory.alloc<float>(numNodes);
+
+	for (int I = 0; I < numNodeRows; I++)
+	{
+		for (int J = 0; J < numNodeColumns; J++)
+		{
+			int k = I * numNodeColumns + J;
+			int i = nodeRow[I] * columns + nodeColumn[J];
+			for (int f = 0; f < numParticleFields; f++)
+				(nodes.*particleFields<float>[f])[k] = (particles.*particleFields<float>[f])[i];
+			if (restShape)
+			{
+				glm::vec3 pos = flatPosition(params, rows, columns, nodeRow[I], nodeColumn[J]);
+				nodes.setPos(k, pos);
+				nodes.setPrevPos(k, pos);
+				nodes.setVel(k, glm::vec3(0.0f));
+				nodes.setForce(k, glm::vec3(0.0f));
+			}
+		}
+	}
+	coarse.setParticles(nodes);
+	if (restShape)
+		coarse.measureRestLengths();
+	return true;
+}
+
+void MultiresCloth::setParticles(const ParticleArrays& state)
+{
+	copyParticles(state, particles, 0, numPoints);
+	velocitiesBehind = false;
+	// Leaves the coarse cloth as it was if there's no memory to restrict with
+	restrictToCoarse(false);
+}
+
+void MultiresCloth::syncParams()
+{
+	// The pins are as many every step, so copying them doesn't allocate
+	ClothParams& coarseParams = coarse.getParams();
+	coarseParams = params;
+	coarseParams.rows = numNodeRows;
+	coarseParams.columns = numNodeColumns;
+	coarseParams.pins = coarsePins;
+	coarseParams.jobs = jobs;
+}
+
+void MultiresCloth::step(float dt, int n)
+{
+	syncParams();
+	coarse.step(dt, n);
+	LapTimer timer;
+	refine();
+	refineTime += timer.lap();
+	stepTimes = coarse.getStepTimes();
+	stepTimes.points += refineTime;
+}
+
+void MultiresCloth::changeStepLength(float from, float to)
+{
+	coarse.changeStepLength(from, to);
+	float ratio = to / from;
+	jobs->parallelFor(0, numPoints, params.grainSize, [this, ratio](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			particles.setPrevPos(i, rescalePrevPos(particles.pos(i), particles.prevPos(i), ratio));
+	});
+}
+
+void MultiresCloth::writeVertices(float alpha, ClothVertex* out) const
+{
+	jobs->parallelFor(0, numPoints, params.grainSize,
+		[this, alpha, out](int begin, int end) { writeClothVertices(particles, begin, end, alpha, out); });
+}
+
+void MultiresCloth::resetStepTimes()
+{
+	coarse.resetStepTimes();
+	refineTime = 0.0;
+	stepTimes = StepTimes();
+}
+
+void MultiresCloth::refine()
+{
+	const ParticleArrays& from = coarse.getParticles();
+	const float* const pos[3] = { from.posX, from.posY, from.posZ };
+	const float* const prevPos[3] = { from.prevX, from.prevY, from.prevZ };
+	float* const toPos[3] = { particles.posX, particles.posY, particles.posZ };
+	float* const toPrevPos[3] = { particles.prevX, particles.prevY, particles.prevZ };
+	prolong(pos, toPos);
+	prolong(prevPos, toPrevPos);
+	velocitiesBehind = true;
+	// At level 0 every point is a coarse one
+	if (level > 0)
+		correct();
+	updateNormals();
+}
+
+const ParticleArrays& MultiresCloth::getParticles() const
+{
+	catchUpVelocities();
+	return particles;
+}
+
+void MultiresCloth::catchUpVelocities() const
+{
+	if (!velocitiesBehind)
+		return;
+	const ParticleArrays& from = coarse.getParticles();
+	const float* const vel[3] = { from.velX, from.velY, from.velZ };
+	float* const toVel[3] = { particles.velX, particles.velY, particles.velZ };
+	prolong(vel, toVel);
+	velocitiesBehind = false;
+}
+
+void MultiresCloth::prolong(const float* const from[3], float* const to[3]) const
+{
+	// Along the coarse rows first, into coarse rows of fine columns
+	int rowGrain = std::max(1, params.grainSize / columns);
+	jobs->parallelFor(0, numNodeRows, rowGrain, [this, from](int begin, int end)
+	{
+		for (int I = begin; I < end; I++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const float* in = from[k] + I * numNodeColumns;
+				float* out = across[k] + I * columns;
+				for (int j = 0; j < columns; j++)
+				{
+					const int* tap = columnTaps + j * 4;
+					const float* w = columnWeights + j * 4;
+					out[j] = w[0] * in[tap[0]] + w[1] * in[tap[1]] + w[2] * in[tap[2]] + w[3] * in[tap[3]];
+				}
+			}
+		}
+	});
+	// Then down the columns, a fine row from four rows of those. Pins stay
+	// where they are.
+	jobs->parallelFor(0, rows, rowGrain, [this, to](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			const int* tap = rowTaps + i * 4;
+			const float w0 = rowWeights[i * 4], w1 = rowWeights[i * 4 + 1], w2 = rowWeights[i * 4 + 2], w3 = rowWeights[i * 4 + 3];
+			const uint8_t* rowPinned = pinned + i * columns;
+			for (int k = 0; k < 3; k++)
+			{
+				const float* in0 = across[k] + tap[0] * columns;
+				const float* in1 = across[k] + tap[1] * columns;
+				const float* in2 = across[k] + tap[2] * columns;
+				const float* in3 = across[k] + tap[3] * columns;
+				float* out = to[k] + i * columns;
+				for (int j = 0; j < columns; j++)
+				{
+					if (!rowPinned[j])
+						out[j] = w0 * in0[j] + w1 * in1[j] + w2 * in2[j] + w3 * in3[j];
+				}
+			}
+		}
+	});
+}
+
+void MultiresCloth::correct()
+{
+	// Most steps nothing is inside anything and there is nothing to correct
+	std::atomic<bool> pushed(false);
+	jobs->parallelFor(0, numPoints, params.grainSize, [this, &pushed](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			baseX[i] = particles.posX[i];
+			baseY[i] = particles.posY[i];
+			baseZ[i] = particles.posZ[i];
+		}
+		if (collideBatch(begin, end))
+			pushed = true;
+	});
+	if (!pushed)
+		return;
+
+	// The springs pull back toward their interpolated lengths
+	jobs->parallelFor(0, numSprings, params.grainSize, [this](int begin, int end)
+	{
+		for (int s = begin; s < end; s++)
+		{
+			uint32_t a = springs.point1[s];
+			uint32_t b = springs.point2[s];
+			springs.restLen[s] = glm::length(glm::vec3(baseX[a] - baseX[b], baseY[a] - baseY[b], baseZ[a] - baseZ[b]));
+		}
+	});
+	for (int it = 0; it < params.multiresIterations; it++)
+	{
+		if (springsColored)
+		{
+			for (int c = 0; c < numSpringColors; c++)
+				jobs->parallelFor(springColorStart[c], springColorStart[c + 1], params.grainSize,
+					[this](int begin, int end) { constraintBatch(begin, end); });
+		}
+		else
+			constraintBatch(0, numSprings);
+		jobs->parallelFor(0, numPoints, params.grainSize, [this](int begin, int end) { collideBatch(begin, end); });
+	}
+
+	// Previous positions move with the points, so drawing between steps
+	// blends from corrected positions too
+	jobs->parallelFor(0, numPoints, params.grainSize, [this](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			if (!isHeld(i))
+			{
+				particles.prevX[i] += particles.posX[i] - baseX[i];
+				particles.prevY[i] += particles.posY[i] - baseY[i];
+				particles.prevZ[i] += particles.posZ[i] - baseZ[i];
+			}
+		}
+	});
+}
+
+// Pushes points out of the floor, the sphere and the props, returns true if any moved
+bool MultiresCloth::collideBatch(int begin, int end)
+{
+	bool moved = false;
+	for (int i = begin; i < end; i++)
+	{
+		if (isHeld(i))
+			continue;
+		glm::vec3 pos = particles.pos(i);
+		glm::vec3 before = pos;
+		// The velocities are the coarse cloth's, a push doesn't bounce them
+		glm::vec3 vel(0.0f);
+		collidePoint(params, pos, vel);
+		if (pos != before)
+		{
+			particles.setPos(i, pos);
+			moved = true;
+		}
+	}
+	return moved;
+}
+
+// One projection of each spring back to its length, points split the move
+// evenly. Springs of a color share no points, so a color can be split up freely.
+void MultiresCloth::constraintBatch(int begin, int end)
+{
+	for (int s = begin; s < end; s++)
+	{
+		uint32_t a = springs.point1[s];
+		uint32_t b = springs.point2[s];
+		float wA = isHeld(a) ? 0.0f : 1.0f;
+		float wB = isHeld(b) ? 0.0f : 1.0f;
+		if (wA + wB == 0.0f)
+			continue;
+
+		glm::vec3 pA = particles.pos(a);
+		glm::vec3 pB = particles.pos(b);
+		glm::vec3 d = pA - pB;
+		float len = glm::length(d);
+		if (len == 0.0f)
+			continue;
+		glm::vec3 move = d * ((springs.restLen[s] - len) / (len * (wA + wB)));
+		particles.setPos(a, pA + wA * move);
+		particles.setPos(b, pB - wB * move);
+	}
+}
+
+// Face normals, then each point's from the up to six faces it is on, as
+// ClothGrid does. Quad (i, j) holds faces 2q and 2q + 1, see the indices.
+void MultiresCloth::updateNormals()
+{
+	int rowGrain = std::max(1, params.grainSize / columns);
+	jobs->parallelFor(0, rows - 1, rowGrain, [this](int begin, int end)
+	{
+		auto setFace = [this](int f, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3)
+		{
+			glm::vec3 n = glm::normalize(glm::cross(p1 - p2, p1 - p3));
+			faceNormX[f] = n.x;
+			faceNormY[f] = n.y;
+			faceNormZ[f] = n.z;
+		};
+		for (int i = begin; i < end; i++)
+		{
+			for (int j = 0; j < columns - 1; j++)
+			{
+				int f = (i * (columns - 1) + j) * 2;
+				int p = i * columns + j;
+				glm::vec3 a = particles.pos(p), b = particles.pos(p + columns);
+				glm::vec3 c = particles.pos(p + columns + 1), d = particles.pos(p + 1);
+				setFace(f, a, b, c);
+				setFace(f + 1, a, c, d);
+			}
+		}
+	});
+	jobs->parallelFor(0, rows, rowGrain, [this](int begin, int end)
+	{
+		auto face = [this](int f) { return glm::vec3(faceNormX[f], faceNormY[f], faceNormZ[f]); };
+		auto gather = [&face](int first, int count, glm::vec3& norm)
+		{
+			for (int f = first; f < first + count; f++)
+				norm += face(f);
+		};
+		for (int i = begin; i < end; i++)
+		{
+			// Inner points are on all six faces, only the edges need checking
+			bool innerRow = i > 0 && i < rows - 1;
+			for (int j = 0; j < columns; j++)
+			{
+				glm::vec3 norm(0.0f);
+				if (innerRow && j > 0 && j < columns - 1)
+				{
+					int below = (i * (columns - 1) + j) * 2;
+					int above = below - (columns - 1) * 2;
+					norm = face(below) + face(below + 1) + face(above) + face(below - 1) + face(above - 2) + face(above - 1);
+				}
+				else
+				{
+					if (i < rows - 1 && j < columns - 1)
+						gather((i * (columns - 1) + j) * 2, 2, norm);
+					if (i > 0 && j < columns - 1)
+						gather(((i - 1) * (columns - 1) + j) * 2, 1, norm);
+					if (i < rows - 1 && j > 0)
+						gather((i * (columns - 1) + j - 1) * 2 + 1, 1, norm);
+					if (i > 0 && j > 0)
+						gather(((i - 1) * (columns - 1) + j - 1) * 2, 2, norm);
+				}
+				particles.setNorm(i * columns + j, finishNormal(norm));
+			}
+		}
+	});
+}
@@ -0,0 +1,156 @@
+#ifndef MULTIRES_CLOTH_H
+#define MULTIRES_CLOTH_H
+
+// High resolution cloth driven by a coarse simulation, for cloths drawn too
+// small or too many to be worth stepping in full. A ClothSolver steps every
+// 2^level-th row and column of the cloth (and always the last ones), a
+// quarter of the points per level, and after each step the points in
+// between are filled in:
+//   - prolongation: Catmull-Rom interpolation across the coarse grid, along
+//     its rows and then down its columns, of the positions and previous
+//     positions. Nothing in a step reads the velocities, they are
+//     interpolated when getParticles() is next called. Points over coarse
+//     points get the coarse values exactly.
+//   - correction: points the interpolation left inside a collider are pushed
+//     out, then params.multiresIterations passes pull the fine springs back
+//     toward their interpolated lengths and push out again, so a push
+//     spreads to the neighbours instead of leaving a dent. Points over
+//     coarse points and pins don't move, so a correction stays inside its
+//     coarse square. Steps where nothing was inside anything skip it.
+// Restriction, taking the coarse points from the fine ones, picks the fine
+// points over them, so setParticles() and snapshots give the coarse cloth
+// back exactly.
+//
+// Each level makes the coarse step a quarter as long, while filling in costs
+// about a third of a full resolution step at any level (two
+// prolongations, the collision test of the correction and the normals). A
+// step is then about 0.6 of a full one at level 1, 0.4 at level 2 and 0.35
+// at level 3, so levels past 2 save little more.
+//
+// The integrator, drag, self collision and sleeping are the coarse cloth's.
+// Level 0 steps every point and fills nothing in. The level is
+// params.multiresLevel, a quality setting, or picked from how big the cloth
+// is drawn with levelForScreenSize(); setLevel() changes it on a running
+// cloth without changing its points.
+
+#include "arena.h"
+#include "cloth.h"
+#include "clothSolver.h"
+#include "coloring.h"
+#include "jobSystem.h"
+
+#include <memory>
+#include <vector>
+
+class MultiresCloth : public Cloth
+{
+public:
+	// Lay the cloth out flat and set the coarse cloth up at
+	// params.multiresLevel. Returns false if the size is out of range or the
+	// memory is not available.
+	bool init(const ClothParams& clothParams) override;
+	// Steps the coarse cloth n times by dt, then fills in the fine points once
+	void step(float dt, int n = 1) override;
+	float getStableStep() const override { return coarse.getStableStep(); }
+	void changeStepLength(float from, float to) override;
+	void wake() override { coarse.wake(); }
+
+	// State accessors
+	ClothParams& getParams() override { return params; }
+	const ClothParams& getParams() const override { return params; }
+	int getRows() const override { return rows; }
+	int getColumns() const override { return columns; }
+	int getNumPoints() const override { return numPoints; }
+	int getNumSprings() const override { return numSprings; }
+	int getNumFaces() const override { return numFaces; }
+	// Prolongs the velocities first if a step left them behind
+	const ParticleArrays& getParticles() const override;
+	void setParticles(const ParticleArrays& state) override;
+	const unsigned int* getIndices() const override { return clothIndices; }
+	void writeVertices(float alpha, ClothVertex* out) const override;
+	size_t getMemoryUsed() const override { return arena.getUsed() + coarse.getMemoryUsed(); }
+	// The coarse cloth's times, filling in counts as points
+	const StepTimes& getStepTimes() const override { return stepTimes; }
+	void resetStepTimes() override;
+
+	// Steps on a grid 2^level times coarser from now on, from where the
+	// points are. Levels past a 2 x 2 coarse grid are lowered to it. Returns
+	// false if the coarse cloth can't be set up, the cloth is unusable then.
+	bool setLevel(int newLevel);
+	int getLevel() const { return level; }
+	const ClothSolver& getCoarse() const { return coarse; }
+	// Coarsest level whose points are at most pixelsPerPoint apart on
+	// screen, for a cloth of params drawn pixels across
+	static int levelForScreenSize(const ClothParams& params, float pixels, float pixelsPerPoint = 8.0f);
+
+private:
+	// Carves every fine buffer out of the arena
+	void layout(Arena& memory);
+	// Hands the coarse cloth the fine points over its points, with restShape
+	// where they lie flat, to measure its rest lengths from
+	bool restrictToCoarse(bool restShape);
+	// The coarse cloth takes every parameter but its size and pins from ours
+	void syncParams();
+	// Prolongation and correction, see the top of the file
+	void refine();
+	void prolong(const float* const from[3], float* const to[3]) const;
+	void catchUpVelocities() const;
+	void correct();
+	bool collideBatch(int begin, int end);
+	void constraintBatch(int begin, int end);
+	void updateNormals();
+	bool isHeld(int i) const { return held[i] != 0; }
+
+	ClothParams params;
+	int rows, columns;
+	int numPoints, numSprings, numFaces;
+	StepTimes stepTimes;
+	double refineTime;
+	// Nothing in a step reads the fine velocities, they are prolonged only
+	// once getParticles() is asked for them
+	mutable bool velocitiesBehind = false;
+
+	ClothSolver coarse;
+	int level;
+	int numNodeRows, numNodeColumns;
+	std::vector<int> coarsePins;
+
+	Arena arena;
+	ParticleArrays particles;
+	// Fine springs, restLen is the length a correction pulls back to
+	SpringArrays springs;
+	unsigned int* clothIndices;
+	uint8_t* pinned;
+	// Pinned or over a coarse point, corrections leave these alone
+	uint8_t* held;
+	// Where the interpolation put each point, before corrections
+	float* baseX;
+	float* baseY;
+	float* baseZ;
+	// One direction of the interpolation, coarse rows by fine columns
+	float* across[3];
+	// Fine row r is interpolated from coarse rows rowTaps[r * 4] .. + 3 with
+	// rowWeights[r * 4] .. + 3, columns likewise
+	int* rowTaps;
+	float* rowWeights;
+	int* columnTaps;
+	float* columnWeights;
+	// Fine row or column of each coarse one
+	int* nodeRow;
+	int* nodeColumn;
+	float* faceNormX;
+	float* faceNormY;
+	float* faceNormZ;
+
+	// Batches of fine springs for the corrections, see colorSprings() in
+	// clothTopology.h
+	int numSpringColors;
+	int springColorStart[maxColors + 1];
+	bool springsColored;
+
+	// Only made when params.jobs doesn't share a job system with us
+	std::unique_ptr<JobSystem> ownJobs;
+	JobSystem* jobs = nullptr;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "scene.h"
+
+Scene::Scene(int threads)
+	: jobs(threads), firstPoint(1, 0)
+{
+	ClothParams defaults;
+	spherePos = defaults.spherePos;
+	sphereR = defaults.sphereR;
+	integrator = defaults.integrator;
+}
+
+// params on the scene's threads, colliders, sphere and integrator
+ClothParams Scene::shared(const ClothParams& params) const
+{
+	ClothParams clothParams = params;
+	clothParams.jobs = &jobs;
+	clothParams.colliders = &colliders;
+	clothParams.spherePos = spherePos;
+	clothParams.sphereR = sphereR;
+	clothParams.integrator = integrator;
+	return clothParams;
+}
+
+bool Scene::add(std::unique_ptr<Cloth> cloth, const ClothParams& params)
+{
+	// The first cloth decides the sphere and integrator, later ones follow it
+	if (cloths.empty())
+	{
+		spherePos = params.spherePos;
+		sphereR = params.sphereR;
+		integrator = params.integrator;
+	}
+	if (!cloth->init(shared(params)))
+		return false;
+
+	int first = firstPoint.back();
+	const unsigned int* clothIndices = cloth->getIndices();
+	for (int k = 0; k < cloth->getNumFaces() * 3; k++)
+		indices.push_back(first + clothIndices[k]);
+	firstPoint.push_back(first + cloth->getNumPoints());
+	cloths.push_back(std::move(cloth));
+	return true;
+}
+
+bool Scene::reset(int i, const ClothParams& params)
+{
+	int numPoints = cloths[i]->getNumPoints();
+	return cloths[i]->init(shared(params)) && cloths[i]->getNumPoints() == numPoints;
+}
+
+int Scene::getNumSprings() const
+{
+	int total = 0;
+	for (const std::unique_ptr<Cloth>& cloth : cloths)
+		total += cloth->getNumSprings();
+	return total;
+}
+
+void Scene::setSpherePos(const glm::vec3& pos)
+{
+	spherePos = pos;
+	for (std::unique_ptr<Cloth>& cloth : cloths)
+		cloth->getParams().spherePos = pos;
+}
+
+void Scene::setSphereR(float r)
+{
+	sphereR = r;
+	for (std::unique_ptr<Cloth>& cloth : cloths)
+		cloth->getParams().sphereR = r;
+}
+
+void Scene::setIntegrator(Integrator newIntegrator)
+{
+	integrator = newIntegrator;
+	for (std::unique_ptr<Cloth>& cloth : cloths)
+		cloth->getParams().integrator = newIntegrator;
+}
+
+void Scene::step(float dt, int n)
+{
+	colliders.build();
+	// One cloth per task, small cloths don't gain from being split further
+	jobs.parallelFor(0, getNumCloths(), 1, [this, dt, n](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			cloths[i]->step(dt, n);
+	});
+}
+
+float Scene::getStableStep() const
+{
+	float stable = 0.0f;
+	for (const std::unique_ptr<Cloth>& cloth : cloths)
+	{
+		float clothStable = cloth->getStableStep();
+		if (clothStable > 0.0f && (stable == 0.0f || clothStable < stable))
+			stable = clothStable;
+	}
+	return stable;
+}
+
+void Scene::changeStepLength(float from, float to)
+{
+	jobs.parallelFor(0, getNumCloths(), 1, [this, from, to](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			cloths[i]->changeStepLength(from, to);
+	});
+}
+
+void Scene::wake()
+{
+	for (std::unique_ptr<Cloth>& cloth : cloths)
+		cloth->wake();
+}
+
+void Scene::writeVertices(float alpha, ClothVertex* out) const
+{
+	jobs.parallelFor(0, getNumCloths(), 1, [this, alpha, out](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			cloths[i]->writeVertices(alpha, out + firstPoint[i]);
+	});
+}
+
+StepTimes Scene::getStepTimes() const
+{
+	StepTimes total;
+	for (const std::unique_ptr<Cloth>& cloth : cloths)
+	{
+		const StepTimes& times = cloth->getStepTimes();
+		total.springs += times.springs;
+		total.faces += times.faces;
+		total.points += times.points;
+		total.steps = times.steps;
+	}
+	return total;
+}
+
+void Scene::resetStepTimes()
+{
+	for (std::unique_ptr<Cloth>& cloth : cloths)
+		cloth->resetStepTimes();
+}
+
+size_t Scene::getMemoryUsed() const
+{
+	size_t total = indices.size() * sizeof(unsigned int) + firstPoint.size() * sizeof(int);
+	for (const std::unique_ptr<Cloth>& cloth : cloths)
+		total += cloth->getMemoryUsed();
+	return total;
+}
@@ -0,0 +1,84 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+// Any number of independent cloths, each with its own size, parameters and
+// pins, sharing one pool of threads, one set of colliders and one sphere.
+// step() hands each cloth to a thread and the cloths' own parallel passes
+// run on the same pool, so a few big cloths and many small ones both keep
+// every core busy without oversubscribing.
+//
+// The points and faces of every cloth are numbered end to end, so the whole
+// scene fits one vertex buffer and one index buffer and draws in one call.
+
+#include "cloth.h"
+#include "colliders.h"
+#include "jobSystem.h"
+
+#include <memory>
+#include <vector>
+
+class Scene
+{
+public:
+	// threads in the shared pool, 0 for one per hardware thread
+	explicit Scene(int threads = 0);
+
+	// Sets cloth up with params on the scene's threads, colliders and
+	// sphere, and adds it. Returns false if the cloth can't be set up.
+	bool add(std::unique_ptr<Cloth> cloth, const ClothParams& params);
+	int getNumCloths() const { return (int)cloths.size(); }
+	Cloth& getCloth(int i) { return *cloths[i]; }
+	const Cloth& getCloth(int i) const { return *cloths[i]; }
+	// Sets cloth i up again with params, as add() would. Returns false if it
+	// can't be set up or its point count would change, cloth i is unusable
+	// after the former.
+	bool reset(int i, const ClothParams& params);
+
+	// Every cloth's points, cloth i's starting at getFirstPoint(i)
+	int getNumPoints() const { return firstPoint.back(); }
+	int getFirstPoint(int i) const { return firstPoint[i]; }
+	int getNumSprings() const;
+	int getNumFaces() const { return (int)indices.size() / 3; }
+	// Faces of every cloth, by scene point
+	const unsigned int* getIndices() const { return indices.data(); }
+
+	// Props shared by every cloth, rebuilt each step
+	ColliderSet& getColliders() { return colliders; }
+	const ColliderSet& getColliders() const { return colliders; }
+	const glm::vec3& getSpherePos() const { return spherePos; }
+	float getSphereR() const { return sphereR; }
+	void setSpherePos(const glm::vec3& pos);
+	void setSphereR(float r);
+	Integrator getIntegrator() const { return integrator; }
+	void setIntegrator(Integrator newIntegrator);
+
+	// Advance every cloth n times by dt, cloths in parallel
+	void step(float dt, int n = 1);
+	// Shortest of the cloths' stable steps, 0 if every one is stable at any step
+	float getStableStep() const;
+	// See Cloth::changeStepLength
+	void changeStepLength(float from, float to);
+	// See Cloth::wake
+	void wake();
+	// Vertices of every cloth end to end, see Cloth::writeVertices
+	void writeVertices(float alpha, ClothVertex* out) const;
+	// Summed over the cloths, so CPU rather than wall time once they run in parallel
+	StepTimes getStepTimes() const;
+	void resetStepTimes();
+	size_t getMemoryUsed() const;
+
+private:
+	ClothParams shared(const ClothParams& params) const;
+
+	// Running jobs doesn't change the pool's state as far as callers can tell
+	mutable JobSystem jobs;
+	ColliderSet colliders;
+	std::vector<std::unique_ptr<Cloth>> cloths;
+	std::vector<int> firstPoint;
+	std::vector<unsigned int> indices;
+	glm::vec3 spherePos;
+	float sphereR;
+	Integrator integrator;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "simThread.h"
+
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Force based integrators need 1 ms steps to stay stable, implicit and XPBD
+// take one step per 60 Hz frame. Cloths that always step explicitly, like a
+// ClothGrid, hold it down to their stable step.
+static float stepFor(const Scene& scene)
+{
+	Integrator integrator = scene.getIntegrator();
+	float step = integrator == INTEGRATOR_IMPLICIT || integrator == INTEGRATOR_XPBD ? 1.0f / 60.0f : 0.001f;
+	float stable = scene.getStableStep();
+	return stable > 0.0f && stable < step ? stable : step;
+}
+
+void ClothSnapshot::blend(float alpha, ClothVertex* out) const
+{
+	for (size_t i = 0; i < current.size(); i++)
+	{
+		out[i].pos = glm::mix(previous[i].pos, current[i].pos, alpha);
+		out[i].norm = current[i].norm;
+	}
+}
+
+SimThread::SimThread(Scene& simScene)
+	: scene(simScene), quit(false)
+{
+	clock.step = stepFor(scene);
+	// Every slot starts out as the current state, so the renderer always has
+	// something to draw
+	for (int i = 0; i < 3; i++)
+	{
+		ClothSnapshot& snapshot = snapshots.slot(i);
+		snapshot.current.resize(scene.getNumPoints());
+		snapshot.previous.resize(scene.getNumPoints());
+		scene.writeVertices(1.0f, snapshot.current.data());
+		scene.writeVertices(0.0f, snapshot.previous.data());
+		snapshot.time = now();
+		snapshot.step = clock.step;
+		snapshot.spherePos = scene.getSpherePos();
+		snapshot.stepTimes = scene.getStepTimes();
+		snapshot.clothMemory = scene.getMemoryUsed();
+	}
+}
+
+SimThread::~SimThread()
+{
+	stop();
+}
+
+void SimThread::start()
+{
+	if (thread.joinable())
+		return;
+	quit.store(false, std::memory_order_relaxed);
+	thread = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop()
+{
+	quit.store(true, std::memory_order_relaxed);
+	if (thread.joinable())
+		thread.join();
+}
+
+bool SimThread::send(const SimInput& input)
+{
+	return inputs.push(input);
+}
+
+double SimThread::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t SimThread::getMemoryUsed() const
+{
+	return 3 * 2 * sizeof(ClothVertex) * (size_t)scene.getNumPoints();
+}
+
+void SimThread::run()
+{
+	scene.resetStepTimes();
+	stepCount = 0;
+	double last = now();
+	while (!quit.load(std::memory_order_relaxed))
+	{
+		SimInput input;
+		while (inputs.pop(input))
+			apply(input);
+
+		double time = now();
+		int substeps = clock.advance((float)(time - last));
+		last = time;
+		if (substeps > 0)
+		{
+			if (adaptiveOn)
+				stepAdaptive(substeps);
+			else
+			{
+				scene.step(clock.step, substeps);
+				stepCount += substeps;
+			}
+			publish();
+		}
+		else
+		{
+			// Nothing due yet, sleep until the next substep is
+			std::this_thread::sleep_for(std::chrono::duration<double>(clock.step - clock.accumulator));
+		}
+	}
+	// A recording still running ends with the thread
+	if (recorder.isRecording())
+		recorder.stop(stepCount, scene);
+}
+
+void SimThread::stepAdaptive(int substeps)
+{
+	// The clock counted substeps of the length before this frame, the
+	// controller may change it every few steps. What is too short for a
+	// whole step goes back to the clock.
+	float time = substeps * clock.step;
+	while (time >= clock.step)
+	{
+		int n = std::min(adaptive.params.interval, (int)(time / clock.step));
+		scene.step(clock.step, n);
+		stepCount += n;
+		time -= n * clock.step;
+		float next = adaptive.update(scene, n);
+		if (next != clock.step)
+			changeStep(next);
+	}
+	clock.accumulator += time;
+}
+
+void SimThread::changeStep(float length)
+{
+	if (length == clock.step)
+		return;
+	scene.changeStepLength(clock.step, length);
+	clock.step = length;
+	if (recorder.isRecording())
+	{
+		SimInput input;
+		input.type = SimInput::STEP_CHANGED;
+		input.integrator = scene.getIntegrator();
+		recorder.record(stepCount, input, clock.step);
+	}
+}
+
+void applyInput(Scene& scene, const SimInput& input)
+{
+	switch (input.type)
+	{
+	case SimInput::MOVE_SPHERE:
+		scene.setSpherePos(scene.getSpherePos() + input.offset);
+		break;
+	case SimInput::SET_INTEGRATOR:
+		scene.setIntegrator(input.integrator);
+		break;
+	default:
+		break;
+	}
+}
+
+void SimThread::apply(const SimInput& input)
+{
+	applyInput(scene, input);
+	// Recorded before any step change it causes, which is recorded as its own
+	// STEP_CHANGED, so the replay rescales after switching as we do
+	if (recorder.isRecording())
+		recorder.record(stepCount, input, clock.step);
+	switch (input.type)
+	{
+	case SimInput::SET_INTEGRATOR:
+		// The points were stepped at the old length, Verlet reads the gap to
+		// prevPos as a velocity
+		if (adaptiveOn)
+			adaptive.reset(scene);
+		changeStep(adaptiveOn ? adaptive.getStep() : stepFor(scene));
+		break;
+	case SimInput::SET_ADAPTIVE:
+		if (input.adaptive == adaptiveOn)
+			break;
+		adaptiveOn = input.adaptive;
+		if (adaptiveOn)
+			adaptive.reset(scene);
+		changeStep(adaptiveOn ? adaptive.getStep() : stepFor(scene));
+		std::cout << (adaptiveOn ? "Adaptive substeps on" : "Adaptive substeps off") << std::endl;
+		break;
+	case SimInput::SAVE_SNAPSHOT:
+		if (saveSnapshot(scene, input.path))
+			std::cout << "Saved " << input.path << std::endl;
+		else
+			std::cout << "Failed to save " << input.path << std::endl;
+		break;
+	case SimInput::START_RECORDING:
+		// The snapshot it starts from can't hold which tiles sleep
+		scene.wake();
+		if (recorder.start(input.path, scene, stepCount, clock.step))
+			std::cout << "Recording input to " << input.path << std::endl;
+		else
+			std::cout << "Failed to record input to " << input.path << std::endl;
+		break;
+	case SimInput::STOP_RECORDING:
+		if (recorder.isRecording())
+			std::cout << (recorder.stop(stepCount, scene) ? "Saved " : "Failed to save ") << recorder.getPath() << std::endl;
+		break;
+	default:
+		break;
+	}
+}
+
+void SimThread::publish()
+{
+	ClothSnapshot& snapshot = snapshots.writeBuffer();
+	scene.writeVertices(1.0f, snapshot.current.data());
+	scene.writeVertices(0.0f, snapshot.previous.data());
+	snapshot.time = now();
+	snapshot.step = clock.step;
+	snapshot.adaptive = adaptiveOn;
+	snapshot.spherePos = scene.getSpherePos();
+	snapshot.stepTimes = scene.getStepTimes();
+	snapshot.clothMemory = scene.getMemoryUsed();
+	snapshots.publish();
+}
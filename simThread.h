@@ -0,0 +1,113 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+// Runs the scene on its own thread so a slow swap under vsync doesn't stall
+// physics and a heavy step doesn't stall rendering. The thread keeps the
+// cloths in step with real time using substeps, of a fixed length for the
+// integrator or picked by an AdaptiveStepController, and publishes a
+// snapshot after each batch of them through a triple buffer. The renderer
+// draws the newest snapshot and sends input back through a queue; after
+// start() only the simulation thread touches the scene.
+
+#include "adaptiveStep.h"
+#include "fixedStep.h"
+#include "inputLog.h"
+#include "scene.h"
+#include "spscRing.h"
+#include "tripleBuffer.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct SimInput
+{
+	enum Type
+	{
+		MOVE_SPHERE,     // moves the sphere by offset
+		SET_INTEGRATOR,  // switches to integrator
+		SAVE_SNAPSHOT,   // saves the scene to path, see snapshot.h
+		SET_CAMERA,      // camera moved to cameraPos looking along cameraFront, only recorded
+		START_RECORDING, // records input from here on to path, see inputLog.h
+		STOP_RECORDING,
+		SET_ADAPTIVE,    // turns adaptive substeps on or off, see adaptiveStep.h
+		STEP_CHANGED     // the substep length changed, only recorded
+	};
+	Type type;
+	glm::vec3 offset;
+	Integrator integrator;
+	bool adaptive;
+	// Not copied, must outlive the input
+	const char* path;
+	glm::vec3 cameraPos, cameraFront;
+};
+
+// What an input changes in the scene, on the simulation thread or in a replay
+void applyInput(Scene& scene, const SimInput& input);
+
+// The scene as the simulation thread last published it
+struct ClothSnapshot
+{
+	// Every cloth's vertices, numbered as in the scene
+	std::vector<ClothVertex> current;
+	// Vertices before the last substep, to blend from
+	std::vector<ClothVertex> previous;
+	// SimThread::now() when published, and the substep length
+	double time = 0.0;
+	float step = 0.0f;
+	bool adaptive = false;
+	glm::vec3 spherePos;
+
+	// Totals since the thread started, difference two snapshots for a frame's worth
+	StepTimes stepTimes;
+	size_t clothMemory = 0;
+
+	// Vertices blended from previous (0) to current (1)
+	void blend(float alpha, ClothVertex* out) const;
+};
+
+class SimThread
+{
+public:
+	// scene must outlive the thread
+	explicit SimThread(Scene& scene);
+	~SimThread();
+	SimThread(const SimThread&) = delete;
+	SimThread& operator=(const SimThread&) = delete;
+
+	void start();
+	// Joins the thread, the scene can be used directly again afterwards
+	void stop();
+
+	// Render side. send returns false if the queue is full and the input was dropped.
+	bool send(const SimInput& input);
+	// Newest published snapshot, valid until the next call
+	const ClothSnapshot& latest() { return snapshots.read(); }
+
+	// Seconds on the clock snapshots are stamped with
+	static double now();
+	size_t getMemoryUsed() const;
+
+private:
+	void run();
+	void apply(const SimInput& input);
+	// Runs substeps of the clock's current length worth of time in adaptive substeps
+	void stepAdaptive(int substeps);
+	// Moves to substeps of length, recorded if recording
+	void changeStep(float length);
+	void publish();
+
+	Scene& scene;
+	FixedStepClock clock;
+	AdaptiveStepController adaptive;
+	bool adaptiveOn = false;
+	// Substeps run since start(), recorded input is stamped with it
+	uint64_t stepCount = 0;
+	InputRecorder recorder;
+	TripleBuffer<ClothSnapshot> snapshots;
+	SpscRing<SimInput, 256> inputs;
+	std::atomic<bool> quit;
+	std::thread thread;
+};
+
+#endif
@@ -0,0 +1,431 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout: header, cloth table, collider table, then per cloth its pins
+// and its particle arrays in particleFields order. Offsets are in bytes from
+// the start of the file.
+
+static const char snapshotMagic[8] = { 'C', 'L', 'O', 'T', 'H', 'S', 'N', 'P' };
+static const uint64_t snapshotAlignment = 64;
+
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	// sizeof(SnapshotHeader), catches builds that pad the records differently
+	uint32_t headerSize;
+	uint64_t fileSize;
+	uint32_t numCloths;
+	uint32_t numColliders;
+	uint64_t clothsOffset;
+	uint64_t collidersOffset;
+	uint32_t integrator;
+	float sphereR;
+	float spherePos[3];
+	uint32_t unused;
+};
+
+// The physical parameters of ClothParams, see there
+struct SnapshotParams
+{
+	int32_t rows, columns;
+	float clothK, dampK;
+	float crossClothK, crossDampK;
+	float bendK, bendDampK;
+	float flagMass, airDensity, clothDragCoef;
+	float airVel[3];
+	float grav[3];
+	int32_t cgIterations;
+	float cgTolerance;
+	int32_t xpbdIterations;
+	float selfThickness;
+	float scale;
+	float origin[3];
+	uint8_t shearSprings, bendSprings, drag, selfCollision;
+	int32_t sleepTile, sleepSteps;
+	float sleepSpeed;
+	uint8_t sleeping, unused[3];
+};
+
+struct SnapshotCloth
+{
+	SnapshotParams params;
+	uint32_t numPoints;
+	uint32_t numPins;
+	uint64_t pinsOffset;
+	uint64_t particleOffsets[numParticleFields];
+};
+
+struct SnapshotCollider
+{
+	uint32_t type;
+	float a[3], b[3];
+	float radius;
+};
+
+static uint64_t alignUp(uint64_t offset)
+{
+	return (offset + snapshotAlignment - 1) & ~(snapshotAlignment - 1);
+}
+
+// True if bytes from offset run past a file of size, without the sum
+// wrapping around
+static bool pastEnd(uint64_t offset, uint64_t bytes, uint64_t size)
+{
+	return offset > size || bytes > size - offset;
+}
+
+static void store(float* out, const glm::vec3& v)
+{
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+}
+
+static glm::vec3 load(const float* in)
+{
+	return glm::vec3(in[0], in[1], in[2]);
+}
+
+static SnapshotParams storeParams(const ClothParams& params)
+{
+	SnapshotParams s;
+	std::memset(&s, 0, sizeof(s));
+	s.rows = params.rows;
+	s.columns = params.columns;
+	s.clothK = params.clothK;
+	s.dampK = params.dampK;
+	s.crossClothK = params.crossClothK;
+	s.crossDampK = params.crossDampK;
+	s.bendK = params.bendK;
+	s.bendDampK = params.bendDampK;
+	s.flagMass = params.flagMass;
+	s.airDensity = params.airDensity;
+	s.clothDragCoef = params.clothDragCoef;
+	store(s.airVel, params.airVel);
+	store(s.grav, params.grav);
+	s.cgIterations = params.cgIterations;
+	s.cgTolerance = params.cgTolerance;
+	s.xpbdIterations = params.xpbdIterations;
+	s.selfThickness = params.selfThickness;
+	s.scale = params.scale;
+	store(s.origin, params.origin);
+	s.shearSprings = params.shearSprings;
+	s.bendSprings = params.bendSprings;
+	s.drag = params.drag;
+	s.selfCollision = params.selfCollision;
+	s.sleepTile = params.sleepTile;
+	s.sleepSteps = params.sleepSteps;
+	s.sleepSpeed = params.sleepSpeed;
+	s.sleeping = params.sleeping;
+	return s;
+}
+
+bool saveSnapshot(const Scene& scene, const char* path)
+{
+	int numCloths = scene.getNumCloths();
+	const ColliderSet& colliders = scene.getColliders();
+
+	SnapshotHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+	header.version = snapshotVersion;
+	header.headerSize = sizeof(SnapshotHeader);
+	header.numCloths = numCloths;
+	header.numColliders = colliders.size();
+	header.integrator = scene.getIntegrator();
+	header.sphereR = scene.getSphereR();
+	store(header.spherePos, scene.getSpherePos());
+
+	// Place everything, then write it front to back
+	uint64_t offset = sizeof(SnapshotHeader);
+	header.clothsOffset = offset = alignUp(offset);
+	offset += sizeof(SnapshotCloth) * numCloths;
+	header.collidersOffset = offset = alignUp(offset);
+	offset += sizeof(SnapshotCollider) * header.numColliders;
+	std::vector<SnapshotCloth> table(numCloths);
+	for (int c = 0; c < numCloths; c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		SnapshotCloth& entry = table[c];
+		std::memset(&entry, 0, sizeof(entry));
+		entry.params = storeParams(cloth.getParams());
+		entry.numPoints = cloth.getNumPoints();
+		entry.numPins = (uint32_t)cloth.getParams().pins.size();
+		entry.pinsOffset = offset = alignUp(offset);
+		offset += sizeof(int32_t) * entry.numPins;
+		for (int f = 0; f < numParticleFields; f++)
+		{
+			entry.particleOffsets[f] = offset = alignUp(offset);
+			offset += sizeof(float) * entry.numPoints;
+		}
+	}
+	header.fileSize = offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	uint64_t written = 0;
+	auto write = [&file, &written](const void* bytes, uint64_t count)
+	{
+		file.write((const char*)bytes, count);
+		written += count;
+	};
+	auto padTo = [&file, &written](uint64_t at)
+	{
+		static const char zeros[snapshotAlignment] = {};
+		file.write(zeros, at - written);
+		written = at;
+	};
+
+	write(&header, sizeof(header));
+	padTo(header.clothsOffset);
+	write(table.data(), sizeof(SnapshotCloth) * numCloths);
+	padTo(header.collidersOffset);
+	for (int i = 0; i < colliders.size(); i++)
+	{
+		const Collider& collider = colliders.get(i);
+		SnapshotCollider entry;
+		entry.type = collider.type;
+		store(entry.a, collider.a);
+		store(entry.b, collider.b);
+		entry.radius = collider.radius;
+		write(&entry, sizeof(entry));
+	}
+	for (int c = 0; c < numCloths; c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		padTo(table[c].pinsOffset);
+		for (int pin : cloth.getParams().pins)
+		{
+			int32_t value = pin;
+			write(&value, sizeof(value));
+		}
+		const ParticleArrays& particles = cloth.getParticles();
+		for (int f = 0; f < numParticleFields; f++)
+		{
+			padTo(table[c].particleOffsets[f]);
+			write(particles.*particleFields<float>[f], sizeof(float) * table[c].numPoints);
+		}
+	}
+	return (bool)file;
+}
+
+bool SnapshotFile::open(const char* path)
+{
+	close();
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	fileHandle = file;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle)
+		data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	size = (size_t)fileSize.QuadPart;
+#else
+	int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat info;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+	{
+		void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping != MAP_FAILED)
+		{
+			data = (const unsigned char*)mapping;
+			size = (size_t)info.st_size;
+		}
+	}
+	// The mapping keeps the file open by itself
+	::close(file);
+#endif
+	if (!data || !check())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void SnapshotFile::close()
+{
+#if defined(_WIN32)
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	if (data)
+		munmap((void*)data, size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+// Every offset lands inside the file and the integrator is a known one, so
+// the accessors can trust them
+bool SnapshotFile::check() const
+{
+	if (size < sizeof(SnapshotHeader))
+		return false;
+	const SnapshotHeader& header = *(const SnapshotHeader*)data;
+	if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+		header.version != snapshotVersion || header.headerSize != sizeof(SnapshotHeader) || header.fileSize != size ||
+		header.integrator > INTEGRATOR_XPBD)
+		return false;
+	if (header.clothsOffset % snapshotAlignment != 0 || header.collidersOffset % snapshotAlignment != 0 ||
+		header.numCloths > size / sizeof(SnapshotCloth) || header.numColliders > size / sizeof(SnapshotCollider) ||
+		pastEnd(header.clothsOffset, sizeof(SnapshotCloth) * header.numCloths, size) ||
+		pastEnd(header.collidersOffset, sizeof(SnapshotCollider) * header.numColliders, size))
+		return false;
+
+	const SnapshotCloth* table = (const SnapshotCloth*)(data + header.clothsOffset);
+	for (uint32_t c = 0; c < header.numCloths; c++)
+	{
+		const SnapshotCloth& entry = table[c];
+		const SnapshotParams& params = entry.params;
+		if (params.rows < 2 || params.columns < 2 || params.rows > maxGridSize || params.columns > maxGridSize ||
+			entry.numPoints != (uint32_t)(params.rows * params.columns))
+			return false;
+		if (entry.numPins > entry.numPoints || entry.pinsOffset % snapshotAlignment != 0 ||
+			pastEnd(entry.pinsOffset, sizeof(int32_t) * entry.numPins, size))
+			return false;
+		const int32_t* pins = (const int32_t*)(data + entry.pinsOffset);
+		for (uint32_t p = 0; p < entry.numPins; p++)
+			if (pins[p] < 0 || pins[p] >= (int32_t)entry.numPoints)
+				return false;
+		for (int f = 0; f < numParticleFields; f++)
+			if (entry.particleOffsets[f] % snapshotAlignment != 0 ||
+				pastEnd(entry.particleOffsets[f], sizeof(float) * entry.numPoints, size))
+				return false;
+	}
+	return true;
+}
+
+int SnapshotFile::getNumCloths() const
+{
+	return ((const SnapshotHeader*)data)->numCloths;
+}
+
+int SnapshotFile::getNumPoints(int cloth) const
+{
+	const SnapshotHeader& header = *(const SnapshotHeader*)data;
+	return ((const SnapshotCloth*)(data + header.clothsOffset))[cloth].numPoints;
+}
+
+ParticleArrays SnapshotFile::getParticles(int cloth) const
+{
+	const SnapshotHeader& header = *(const SnapshotHeader*)data;
+	const SnapshotCloth& entry = ((const SnapshotCloth*)(data + header.clothsOffset))[cloth];
+	// The arrays are never written through, the mapping is read only
+	ParticleArrays particles;
+	for (int f = 0; f < numParticleFields; f++)
+		particles.*particleFields<float>[f] = (float*)(data + entry.particleOffsets[f]);
+	return particles;
+}
+
+ClothParams SnapshotFile::getParams(int cloth, const ClothParams& base) const
+{
+	const SnapshotHeader& header = *(const SnapshotHeader*)data;
+	const SnapshotCloth& entry = ((const SnapshotCloth*)(data + header.clothsOffset))[cloth];
+	const SnapshotParams& s = entry.params;
+	ClothParams params = base;
+	params.rows = s.rows;
+	params.columns = s.columns;
+	params.clothK = s.clothK;
+	params.dampK = s.dampK;
+	params.crossClothK = s.crossClothK;
+	params.crossDampK = s.crossDampK;
+	params.bendK = s.bendK;
+	params.bendDampK = s.bendDampK;
+	params.flagMass = s.flagMass;
+	params.airDensity = s.airDensity;
+	params.clothDragCoef = s.clothDragCoef;
+	params.airVel = load(s.airVel);
+	params.grav = load(s.grav);
+	params.cgIterations = s.cgIterations;
+	params.cgTolerance = s.cgTolerance;
+	params.xpbdIterations = s.xpbdIterations;
+	params.selfThickness = s.selfThickness;
+	params.scale = s.scale;
+	params.origin = load(s.origin);
+	params.shearSprings = s.shearSprings != 0;
+	params.bendSprings = s.bendSprings != 0;
+	params.drag = s.drag != 0;
+	params.selfCollision = s.selfCollision != 0;
+	params.sleepTile = s.sleepTile;
+	params.sleepSteps = s.sleepSteps;
+	params.sleepSpeed = s.sleepSpeed;
+	params.sleeping = s.sleeping != 0;
+	params.integrator = (Integrator)header.integrator;
+	params.sphereR = header.sphereR;
+	params.spherePos = load(header.spherePos);
+	const int32_t* pins = (const int32_t*)(data + entry.pinsOffset);
+	params.pins.assign(pins, pins + entry.numPins);
+	return params;
+}
+
+bool SnapshotFile::restore(Scene& scene) const
+{
+	const SnapshotHeader& header = *(const SnapshotHeader*)data;
+	const SnapshotCloth* table = (const SnapshotCloth*)(data + header.clothsOffset);
+	if (scene.getNumCloths() != (int)header.numCloths)
+		return false;
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		const Cloth& cloth = scene.getCloth(c);
+		if (cloth.getRows() != table[c].params.rows || cloth.getColumns() != table[c].params.columns)
+			return false;
+	}
+
+	scene.setSpherePos(load(header.spherePos));
+	scene.setSphereR(header.sphereR);
+	scene.setIntegrator((Integrator)header.integrator);
+	ColliderSet& colliders = scene.getColliders();
+	colliders.clear();
+	const SnapshotCollider* saved = (const SnapshotCollider*)(data + header.collidersOffset);
+	for (uint32_t i = 0; i < header.numColliders; i++)
+	{
+		const SnapshotCollider& c = saved[i];
+		if (c.type == COLLIDER_SPHERE)
+			colliders.addSphere(load(c.a), c.radius);
+		else if (c.type == COLLIDER_CAPSULE)
+			colliders.addCapsule(load(c.a), load(c.b), c.radius);
+		else
+			colliders.addBox(load(c.a), load(c.b));
+	}
+	colliders.build();
+
+	for (int c = 0; c < scene.getNumCloths(); c++)
+	{
+		if (!scene.reset(c, getParams(c, scene.getCloth(c).getParams())))
+			return false;
+		scene.getCloth(c).setParticles(getParticles(c));
+	}
+	return true;
+}
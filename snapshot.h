@@ -0,0 +1,77 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// Saved scene state for warm starts: every cloth's particles and parameters,
+// the sphere, the integrator and the props. A draped scene can be saved once
+// and later runs start from it instead of simulating the drape again.
+//
+// The file is laid out to be used where it lies. A fixed header and a table
+// of cloths point at the data by byte offset, and every particle array starts
+// on a 64 byte boundary, as in the solver's arena. Opening a snapshot maps
+// the file and checks the offsets, nothing is parsed. getParticles() hands
+// back arrays that point into the mapping, and restore() copies them into
+// the cloths.
+//
+// Values are stored in the machine's own byte order, so a snapshot only
+// loads on machines with the same one. Files with any other version are
+// rejected; bump snapshotVersion whenever the layout changes.
+//
+// A snapshot holds state, not the cloths themselves. The scene it is
+// restored into must have the same number of cloths, each with as many
+// points as the one that was saved. Threads, grain size and SIMD level stay
+// as the scene has them. Which parts of a cloth sleep isn't saved, a
+// restored cloth starts with all of it awake.
+
+#include "scene.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Version 2 added the sleeping parameters
+const uint32_t snapshotVersion = 2;
+
+// Writes scene's state to path, returns false if the file can't be written
+bool saveSnapshot(const Scene& scene, const char* path);
+
+class SnapshotFile
+{
+public:
+	SnapshotFile() {}
+	~SnapshotFile() { close(); }
+	SnapshotFile(const SnapshotFile&) = delete;
+	SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+	// Maps path read only. Returns false if it can't be mapped or isn't a
+	// snapshot of this version.
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+	size_t getSize() const { return size; }
+
+	int getNumCloths() const;
+	int getNumPoints(int cloth) const;
+	// Cloth's saved particles, pointing into the mapping. Only valid while
+	// the file is open.
+	ParticleArrays getParticles(int cloth) const;
+	// Cloth's saved parameters over base, which supplies whatever isn't
+	// saved (threads, SIMD level and such)
+	ClothParams getParams(int cloth, const ClothParams& base) const;
+
+	// Sets every cloth, the sphere, the integrator and the props of scene to
+	// the saved state. Returns false if scene doesn't match the snapshot's
+	// cloths, scene is unchanged then. Also returns false if a cloth can't be
+	// set up again, e.g. out of memory, which leaves scene partly restored.
+	bool restore(Scene& scene) const;
+
+private:
+	bool check() const;
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#if defined(_WIN32)
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "springKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CLOTH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define CLOTH_X86 0
+#endif
+
+// GCC and Clang only allow the intrinsics in functions built for that
+// instruction set, MSVC allows them anywhere. AVX-512 brings FMA with it, which
+// GCC would fuse the multiplies and adds into, so contraction is turned off to
+// keep the results identical to the scalar kernel.
+#if defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+// CPU detection ------------------------------
+
+SimdLevel detectSimdLevel()
+{
+#if CLOTH_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return SIMD_SCALAR;
+	// The OS has to save the wide registers as well as the CPU having them
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return SIMD_SCALAR;
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	if ((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6)
+		return SIMD_AVX512;
+	if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6)
+		return SIMD_AVX2;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+#endif
+#endif
+	return SIMD_SCALAR;
+}
+
+SpringKernel getSpringKernel(SimdLevel level)
+{
+	static const SimdLevel supported = detectSimdLevel();
+	if (level > supported)
+		level = supported;
+
+	switch (level)
+	{
+	case SIMD_AVX512:
+		return springForcesAVX512;
+	case SIMD_AVX2:
+		return springForcesAVX2;
+	default:
+		return springForcesScalar;
+	}
+}
+
+SpringStripKernel getSpringStripKernel(SimdLevel level)
+{
+	static const SimdLevel supported = detectSimdLevel();
+	if (level > supported)
+		level = supported;
+
+	switch (level)
+	{
+	case SIMD_AVX512:
+		return springStripAVX512;
+	case SIMD_AVX2:
+		return springStripAVX2;
+	default:
+		return springStripScalar;
+	}
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_AVX512:
+		return "avx512";
+	case SIMD_AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+// Kernels ------------------------------------
+
+void springForcesScalar(const ParticleArrays& p, SpringArrays& s, int begin, int end)
+{
+	springForcesPortable(p, s, begin, end);
+}
+
+void springStripScalar(const ParticleArrays& p, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ)
+{
+	for (int a = begin; a < end; a++)
+	{
+		int b = a + offset;
+		float dx = p.posX[a] - p.posX[b];
+		float dy = p.posY[a] - p.posY[b];
+		float dz = p.posZ[a] - p.posZ[b];
+		float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+		float inv = 1.0f / len;
+		float dirX = dx * inv;
+		float dirY = dy * inv;
+		float dirZ = dz * inv;
+		// Stretch
+		float sForce = (restLen - len) * k;
+		// Dampen velocities along the spring
+		float v1 = p.velX[a] * dirX + p.velY[a] * dirY + p.velZ[a] * dirZ;
+		float v2 = p.velX[b] * dirX + p.velY[b] * dirY + p.velZ[b] * dirZ;
+		float f = sForce - vK * (v1 - v2);
+		forceX[a] = f * dirX;
+		forceY[a] = f * dirY;
+		forceZ[a] = f * dirZ;
+	}
+}
+
+#if CLOTH_X86
+
+TARGET_AVX2 void springForcesAVX2(const ParticleArrays& p, SpringArrays& s, int begin, int end)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(s.point1 + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(s.point2 + i));
+		__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(p.posX, a, 4), _mm256_i32gather_ps(p.posX, b, 4));
+		__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(p.posY, a, 4), _mm256_i32gather_ps(p.posY, b, 4));
+		__m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(p.posZ, a, 4), _mm256_i32gather_ps(p.posZ, b, 4));
+		__m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		__m256 len = _mm256_sqrt_ps(len2);
+		__m256 inv = _mm256_div_ps(one, len);
+		__m256 dirX = _mm256_mul_ps(dx, inv);
+		__m256 dirY = _mm256_mul_ps(dy, inv);
+		__m256 dirZ = _mm256_mul_ps(dz, inv);
+		// Stretch
+		__m256 sForce = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.restLen + i), len), _mm256_loadu_ps(s.k + i));
+		// Dampen velocities along the spring
+		__m256 v1 = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(_mm256_i32gather_ps(p.velX, a, 4), dirX),
+			_mm256_mul_ps(_mm256_i32gather_ps(p.velY, a, 4), dirY)),
+			_mm256_mul_ps(_mm256_i32gather_ps(p.velZ, a, 4), dirZ));
+		__m256 v2 = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(_mm256_i32gather_ps(p.velX, b, 4), dirX),
+			_mm256_mul_ps(_mm256_i32gather_ps(p.velY, b, 4), dirY)),
+			_mm256_mul_ps(_mm256_i32gather_ps(p.velZ, b, 4), dirZ));
+		__m256 f = _mm256_sub_ps(sForce, _mm256_mul_ps(_mm256_loadu_ps(s.vK + i), _mm256_sub_ps(v1, v2)));
+		_mm256_storeu_ps(s.forceX + i, _mm256_mul_ps(f, dirX));
+		_mm256_storeu_ps(s.forceY + i, _mm256_mul_ps(f, dirY));
+		_mm256_storeu_ps(s.forceZ + i, _mm256_mul_ps(f, dirZ));
+	}
+	springForcesScalar(p, s, i, end);
+}
+
+TARGET_AVX2 void springStripAVX2(const ParticleArrays& p, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 rest = _mm256_set1_ps(restLen);
+	const __m256 stiff = _mm256_set1_ps(k);
+	const __m256 damp = _mm256_set1_ps(vK);
+	int a = begin;
+	for (; a + 8 <= end; a += 8)
+	{
+		int b = a + offset;
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(p.posX + a), _mm256_loadu_ps(p.posX + b));
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(p.posY + a), _mm256_loadu_ps(p.posY + b));
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(p.posZ + a), _mm256_loadu_ps(p.posZ + b));
+		__m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		__m256 len = _mm256_sqrt_ps(len2);
+		__m256 inv = _mm256_div_ps(one, len);
+		__m256 dirX = _mm256_mul_ps(dx, inv);
+		__m256 dirY = _mm256_mul_ps(dy, inv);
+		__m256 dirZ = _mm256_mul_ps(dz, inv);
+		// Stretch
+		__m256 sForce = _mm256_mul_ps(_mm256_sub_ps(rest, len), stiff);
+		// Dampen velocities along the spring
+		__m256 v1 = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(_mm256_loadu_ps(p.velX + a), dirX),
+			_mm256_mul_ps(_mm256_loadu_ps(p.velY + a), dirY)),
+			_mm256_mul_ps(_mm256_loadu_ps(p.velZ + a), dirZ));
+		__m256 v2 = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(_mm256_loadu_ps(p.velX + b), dirX),
+			_mm256_mul_ps(_mm256_loadu_ps(p.velY + b), dirY)),
+			_mm256_mul_ps(_mm256_loadu_ps(p.velZ + b), dirZ));
+		__m256 f = _mm256_sub_ps(sForce, _mm256_mul_ps(damp, _mm256_sub_ps(v1, v2)));
+		_mm256_storeu_ps(forceX + a, _mm256_mul_ps(f, dirX));
+		_mm256_storeu_ps(forceY + a, _mm256_mul_ps(f, dirY));
+		_mm256_storeu_ps(forceZ + a, _mm256_mul_ps(f, dirZ));
+	}
+	springStripScalar(p, a, end, offset, restLen, k, vK, forceX, forceY, forceZ);
+}
+
+TARGET_AVX512 void springForcesAVX512(const ParticleArrays& p, SpringArrays& s, int begin, int end)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	int i = begin;
+	for (; i + 16 <= end; i += 16)
+	{
+		__m512i a = _mm512_loadu_si512((const void*)(s.point1 + i));
+		__m512i b = _mm512_loadu_si512((const void*)(s.point2 + i));
+		__m512 dx = _mm512_sub_ps(_mm512_i32gather_ps(a, p.posX, 4), _mm512_i32gather_ps(b, p.posX, 4));
+		__m512 dy = _mm512_sub_ps(_mm512_i32gather_ps(a, p.posY, 4), _mm512_i32gather_ps(b, p.posY, 4));
+		__m512 dz = _mm512_sub_ps(_mm512_i32gather_ps(a, p.posZ, 4), _mm512_i32gather_ps(b, p.posZ, 4));
+		__m512 len2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+		__m512 len = _mm512_sqrt_ps(len2);
+		__m512 inv = _mm512_div_ps(one, len);
+		__m512 dirX = _mm512_mul_ps(dx, inv);
+		__m512 dirY = _mm512_mul_ps(dy, inv);
+		__m512 dirZ = _mm512_mul_ps(dz, inv);
+		// Stretch
+		__m512 sForce = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(s.restLen + i), len), _mm512_loadu_ps(s.k + i));
+		// Dampen velocities along the spring
+		__m512 v1 = _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(_mm512_i32gather_ps(a, p.velX, 4), dirX),
+			_mm512_mul_ps(_mm512_i32gather_ps(a, p.velY, 4), dirY)),
+			_mm512_mul_ps(_mm512_i32gather_ps(a, p.velZ, 4), dirZ));
+		__m512 v2 = _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(_mm512_i32gather_ps(b, p.velX, 4), dirX),
+			_mm512_mul_ps(_mm512_i32gather_ps(b, p.velY, 4), dirY)),
+			_mm512_mul_ps(_mm512_i32gather_ps(b, p.velZ, 4), dirZ));
+		__m512 f = _mm512_sub_ps(sForce, _mm512_mul_ps(_mm512_loadu_ps(s.vK + i), _mm512_sub_ps(v1, v2)));
+		_mm512_storeu_ps(s.forceX + i, _mm512_mul_ps(f, dirX));
+		_mm512_storeu_ps(s.forceY + i, _mm512_mul_ps(f, dirY));
+		_mm512_storeu_ps(s.forceZ + i, _mm512_mul_ps(f, dirZ));
+	}
+	springForcesScalar(p, s, i, end);
+}
+
+TARGET_AVX512 void springStripAVX512(const ParticleArrays& p, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 rest = _mm512_set1_ps(restLen);
+	const __m512 stiff = _mm512_set1_ps(k);
+	const __m512 damp = _mm512_set1_ps(vK);
+	int a = begin;
+	for (; a + 16 <= end; a += 16)
+	{
+		int b = a + offset;
+		__m512 dx = _mm512_sub_ps(_mm512_loadu_ps(p.posX + a), _mm512_loadu_ps(p.posX + b));
+		__m512 dy = _mm512_sub_ps(_mm512_loadu_ps(p.posY + a), _mm512_loadu_ps(p.posY + b));
+		__m512 dz = _mm512_sub_ps(_mm512_loadu_ps(p.posZ + a), _mm512_loadu_ps(p.posZ + b));
+		__m512 len2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+		__m512 len = _mm512_sqrt_ps(len2);
+		__m512 inv = _mm512_div_ps(one, len);
+		__m512 dirX = _mm512_mul_ps(dx, inv);
+		__m512 dirY = _mm512_mul_ps(dy, inv);
+		__m512 dirZ = _mm512_mul_ps(dz, inv);
+		// Stretch
+		__m512 sForce = _mm512_mul_ps(_mm512_sub_ps(rest, len), stiff);
+		// Dampen velocities along the spring
+		__m512 v1 = _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(_mm512_loadu_ps(p.velX + a), dirX),
+			_mm512_mul_ps(_mm512_loadu_ps(p.velY + a), dirY)),
+			_mm512_mul_ps(_mm512_loadu_ps(p.velZ + a), dirZ));
+		__m512 v2 = _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(_mm512_loadu_ps(p.velX + b), dirX),
+			_mm512_mul_ps(_mm512_loadu_ps(p.velY + b), dirY)),
+			_mm512_mul_ps(_mm512_loadu_ps(p.velZ + b), dirZ));
+		__m512 f = _mm512_sub_ps(sForce, _mm512_mul_ps(damp, _mm512_sub_ps(v1, v2)));
+		_mm512_storeu_ps(forceX + a, _mm512_mul_ps(f, dirX));
+		_mm512_storeu_ps(forceY + a, _mm512_mul_ps(f, dirY));
+		_mm512_storeu_ps(forceZ + a, _mm512_mul_ps(f, dirZ));
+	}
+	springStripScalar(p, a, end, offset, restLen, k, vK, forceX, forceY, forceZ);
+}
+
+#else
+
+// No wide kernels on this architecture, getSpringKernel never picks these
+void springForcesAVX2(const ParticleArrays& p, SpringArrays& s, int begin, int end)
+{
+	springForcesScalar(p, s, begin, end);
+}
+
+void springForcesAVX512(const ParticleArrays& p, SpringArrays& s, int begin, int end)
+{
+	springForcesScalar(p, s, begin, end);
+}
+
+void springStripAVX2(const ParticleArrays& p, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ)
+{
+	springStripScalar(p, begin, end, offset, restLen, k, vK, forceX, forceY, forceZ);
+}
+
+void springStripAVX512(const ParticleArrays& p, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ)
+{
+	springStripScalar(p, begin, end, offset, restLen, k, vK, forceX, forceY, forceZ);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SPRING_KERNELS_H
+#define SPRING_KERNELS_H
+
+// Spring force kernels. Each kernel evaluates the stretch and damping force of
+// springs [begin, end) and writes the force on point1 into the spring's
+// forceX/Y/Z. All variants do the same float operations in the same order, so
+// they give bit-identical results and can be swapped freely. The wide
+// kernels are float only, the double precision solver uses the portable one.
+
+#include "clothData.h"
+
+#include <cmath>
+
+enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_AVX2,   // 8 springs per instruction
+	SIMD_AVX512  // 16 springs per instruction
+};
+
+typedef void(*SpringKernel)(const ParticleArrays& particles, SpringArrays& springs, int begin, int end);
+// Springs from every point i in [begin, end) to point i + offset, all with the
+// same rest length and constants, as one direction of a regular grid is. The
+// force on point i goes to forceX/Y/Z[i]. The points are read straight, not
+// gathered.
+typedef void(*SpringStripKernel)(const ParticleArrays& particles, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ);
+
+// Best instruction set supported by this CPU and OS
+SimdLevel detectSimdLevel();
+// Kernel for the given level, falling back to the best available one below it
+SpringKernel getSpringKernel(SimdLevel level);
+SpringStripKernel getSpringStripKernel(SimdLevel level);
+const char* simdLevelName(SimdLevel level);
+
+// One spring at a time in any precision, springForcesScalar is the float one
+template <typename Scalar>
+void springForcesPortable(const BasicParticleArrays<Scalar>& p, BasicSpringArrays<Scalar>& s, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		uint32_t a = s.point1[i];
+		uint32_t b = s.point2[i];
+		Scalar dx = p.posX[a] - p.posX[b];
+		Scalar dy = p.posY[a] - p.posY[b];
+		Scalar dz = p.posZ[a] - p.posZ[b];
+		Scalar len = std::sqrt(dx * dx + dy * dy + dz * dz);
+		Scalar inv = Scalar(1) / len;
+		Scalar dirX = dx * inv;
+		Scalar dirY = dy * inv;
+		Scalar dirZ = dz * inv;
+		// Stretch
+		Scalar sForce = (s.restLen[i] - len) * s.k[i];
+		// Dampen velocities along the spring
+		Scalar v1 = p.velX[a] * dirX + p.velY[a] * dirY + p.velZ[a] * dirZ;
+		Scalar v2 = p.velX[b] * dirX + p.velY[b] * dirY + p.velZ[b] * dirZ;
+		Scalar f = sForce - s.vK[i] * (v1 - v2);
+		s.forceX[i] = f * dirX;
+		s.forceY[i] = f * dirY;
+		s.forceZ[i] = f * dirZ;
+	}
+}
+
+void springForcesScalar(const ParticleArrays& particles, SpringArrays& springs, int begin, int end);
+void springForcesAVX2(const ParticleArrays& particles, SpringArrays& springs, int begin, int end);
+void springForcesAVX512(const ParticleArrays& particles, SpringArrays& springs, int begin, int end);
+
+void springStripScalar(const ParticleArrays& particles, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ);
+void springStripAVX2(const ParticleArrays& particles, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ);
+void springStripAVX512(const ParticleArrays& particles, int begin, int end, int offset,
+	float restLen, float k, float vK, float* forceX, float* forceY, float* forceZ);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+// Fixed size queue for one producer thread and one consumer thread. Neither
+// side ever locks or waits: push fails when the ring is full and pop fails
+// when it is empty, so a hot loop can hand data to another thread without
+// being slowed down by it.
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, int Capacity>
+class SpscRing
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscRing() : head(0), tail(0) {}
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// Producer only, returns false if the ring is full
+	bool push(const T& value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity)
+			return false;
+		slots[t & (Capacity - 1)] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, returns false if the ring is empty
+	bool pop(T& value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		value = slots[h & (Capacity - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+	// Kept on separate cache lines so the two threads don't fight over them
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+	alignas(64) T slots[Capacity];
+};
+
+#endif
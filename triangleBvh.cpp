@@ -0,0 +1,106 @@
+#include "triangleBvh.h"
+
+#include <algorithm>
+
+template <typename Scalar>
+void BasicTriangleBvh<Scalar>::layout(Arena& memory, int numFaces)
+{
+	// Halving down to leafSize faces takes fewer than two nodes per face
+	nodes = memory.alloc<BvhNode<Scalar>>(2 * numFaces);
+	order = memory.alloc<uint32_t>(numFaces);
+	leaves = memory.alloc<uint32_t>(numFaces);
+}
+
+template <typename Scalar>
+void BasicTriangleBvh<Scalar>::build(const unsigned int* faceIndices, int numFaces, const BasicParticleArrays<Scalar>& particles)
+{
+	indices = faceIndices;
+	numNodes = 0;
+	numLeaves = 0;
+	std::vector<Vec3> centroids(numFaces);
+	for (int f = 0; f < numFaces; f++)
+	{
+		order[f] = f;
+		centroids[f] = (particles.pos(indices[f * 3]) + particles.pos(indices[f * 3 + 1]) + particles.pos(indices[f * 3 + 2])) / Scalar(3);
+	}
+	buildNode(0, numFaces, centroids);
+}
+
+// Splits faces order[first] .. order[first + count - 1] in half across the
+// longest side of their centroids' box
+template <typename Scalar>
+uint32_t BasicTriangleBvh<Scalar>::buildNode(uint32_t first, uint32_t count, std::vector<Vec3>& centroids)
+{
+	uint32_t index = numNodes++;
+	BvhNode<Scalar>& node = nodes[index];
+	if (count <= leafSize)
+	{
+		node.first = first;
+		node.count = count;
+		node.right = 0;
+		leaves[numLeaves++] = index;
+		return index;
+	}
+
+	Vec3 lo(centroids[order[first]]), hi(lo);
+	for (uint32_t k = first + 1; k < first + count; k++)
+	{
+		lo = glm::min(lo, centroids[order[k]]);
+		hi = glm::max(hi, centroids[order[k]]);
+	}
+	Vec3 size = hi - lo;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	uint32_t half = count / 2;
+	std::nth_element(order + first, order + first + half, order + first + count,
+		[&centroids, axis](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	node.first = 0;
+	node.count = 0;
+	buildNode(first, half, centroids);
+	uint32_t right = buildNode(first + half, count - half, centroids);
+	nodes[index].right = right;
+	return index;
+}
+
+template <typename Scalar>
+void BasicTriangleBvh<Scalar>::fitLeaf(BvhNode<Scalar>& node, const BasicParticleArrays<Scalar>& particles) const
+{
+	Vec3 lo = particles.pos(indices[order[node.first] * 3]);
+	Vec3 hi = lo;
+	for (uint32_t k = node.first; k < node.first + node.count; k++)
+	{
+		for (int v = 0; v < 3; v++)
+		{
+			Vec3 p = particles.pos(indices[order[k] * 3 + v]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+	}
+	node.lo = lo;
+	node.hi = hi;
+}
+
+template <typename Scalar>
+void BasicTriangleBvh<Scalar>::refit(const BasicParticleArrays<Scalar>& particles, JobSystem& jobs, int grain)
+{
+	// Leaves are independent, then each inner node from its children, which
+	// come after it
+	jobs.parallelFor(0, (int)numLeaves, grain, [this, &particles](int begin, int end)
+	{
+		for (int l = begin; l < end; l++)
+			fitLeaf(nodes[leaves[l]], particles);
+	});
+	for (uint32_t n = numNodes; n-- > 0;)
+	{
+		BvhNode<Scalar>& node = nodes[n];
+		if (node.count > 0)
+			continue;
+		const BvhNode<Scalar>& left = nodes[n + 1];
+		const BvhNode<Scalar>& right = nodes[node.right];
+		node.lo = glm::min(left.lo, right.lo);
+		node.hi = glm::max(left.hi, right.hi);
+	}
+}
+
+template class BasicTriangleBvh<float>;
+template class BasicTriangleBvh<double>;
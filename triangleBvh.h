@@ -0,0 +1,91 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+// Bounding volume hierarchy over the cloth's triangles, for finding the
+// triangles near a point. The cloth never changes topology, so the tree is
+// built once from the rest pose and afterwards only refit: boxes grow and
+// shrink around the triangles where they are now, the tree shape stays. The
+// tree gets looser as the cloth folds, but refitting is far cheaper than
+// rebuilding every step.
+//
+// Nodes are stored depth first, an inner node's left child is the next node
+// and its children always come after it, so refitting is one backwards pass.
+// Queries only read the tree and can run on any number of threads. Boxes
+// are in the precision of the particles they are fit to.
+
+#include "arena.h"
+#include "clothData.h"
+#include "jobSystem.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+template <typename Scalar>
+struct BvhNode
+{
+	glm::tvec3<Scalar> lo, hi;
+	// Leaves hold faces order[first] .. order[first + count - 1], inner nodes
+	// have count 0 and their right child at right
+	uint32_t first, count, right;
+};
+
+template <typename Scalar>
+class BasicTriangleBvh
+{
+public:
+	typedef glm::tvec3<Scalar> Vec3;
+
+	static const int leafSize = 4;
+
+	// Carves room for a tree over numFaces triangles out of memory
+	void layout(Arena& memory, int numFaces);
+	// Builds the tree around the triangles where they are now. indices must
+	// outlive the tree.
+	void build(const unsigned int* indices, int numFaces, const BasicParticleArrays<Scalar>& particles);
+	// Fits every box to the triangles' current positions
+	void refit(const BasicParticleArrays<Scalar>& particles, JobSystem& jobs, int grain);
+
+	// Calls fn(face) for every triangle whose box is within radius of p
+	template <typename Fn>
+	void query(const Vec3& p, Scalar radius, Fn fn) const
+	{
+		uint32_t stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			const BvhNode<Scalar>& node = nodes[stack[--top]];
+			// Written as a test for overlap so a NaN box is skipped
+			if (!(p.x + radius >= node.lo.x && p.y + radius >= node.lo.y && p.z + radius >= node.lo.z &&
+				p.x - radius <= node.hi.x && p.y - radius <= node.hi.y && p.z - radius <= node.hi.z))
+				continue;
+			if (node.count > 0)
+			{
+				for (uint32_t k = node.first; k < node.first + node.count; k++)
+					fn(order[k]);
+			}
+			else
+			{
+				stack[top++] = node.right;
+				stack[top++] = (uint32_t)(&node - nodes) + 1;
+			}
+		}
+	}
+
+private:
+	uint32_t buildNode(uint32_t first, uint32_t count, std::vector<Vec3>& centroids);
+	void fitLeaf(BvhNode<Scalar>& node, const BasicParticleArrays<Scalar>& particles) const;
+
+	const unsigned int* indices = nullptr;
+	BvhNode<Scalar>* nodes = nullptr;
+	uint32_t* order = nullptr;
+	uint32_t* leaves = nullptr;
+	uint32_t numNodes = 0;
+	uint32_t numLeaves = 0;
+};
+
+typedef BasicTriangleBvh<float> TriangleBvh;
+
+#endif
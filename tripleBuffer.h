@@ -0,0 +1,54 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// Hands the newest value from one producer thread to one consumer thread
+// without locks. The producer fills writeBuffer() and publishes it, the
+// consumer reads the newest published value. With three slots neither side
+// ever waits for the other: one is being written, one being read and the
+// third holds the latest published value. Values the consumer was too slow
+// to see are skipped.
+//
+// The slots are reused, so a value holding vectors keeps their memory
+// between publishes.
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : back(0), middle(1), front(2) {}
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Any slot, only for setting them up before the threads start
+	T& slot(int i) { return slots[i]; }
+
+	// Producer only
+	T& writeBuffer() { return slots[back]; }
+	void publish()
+	{
+		back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// Consumer only. Swaps in the newest published value if there is one and
+	// returns it, it stays valid until the next read().
+	const T& read()
+	{
+		if (middle.load(std::memory_order_relaxed) & freshBit)
+			front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		return slots[front];
+	}
+
+private:
+	static const int indexMask = 3;
+	// Set on middle when it holds a value the consumer hasn't seen
+	static const int freshBit = 4;
+
+	T slots[3];
+	int back;
+	std::atomic<int> middle;
+	int front;
+};
+
+#endif
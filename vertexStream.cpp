@@ -0,0 +1,143 @@
+#include "vertexStream.h"
+
+#include <cstring>
+
+// Buffer storage is newer than the GL 3.3 core our glad loads, so its entry
+// point and flags are looked up here
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static bool hasBufferStorage()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && std::strcmp(name, "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+	return false;
+}
+
+VertexStream::VertexStream()
+	: buffer(0), posAttrib(0), normAttrib(0), numVertices(0), regionBytes(0), region(0), persistent(false), mapped(nullptr)
+{
+	for (int r = 0; r < numRegions; r++)
+		fences[r] = nullptr;
+}
+
+VertexStream::~VertexStream()
+{
+	release();
+}
+
+bool VertexStream::init(int vertexCount, GLADloadproc load, unsigned int posIndex, unsigned int normIndex)
+{
+	release();
+	numVertices = vertexCount;
+	regionBytes = sizeof(ClothVertex) * numVertices;
+	posAttrib = posIndex;
+	normAttrib = normIndex;
+	region = 0;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	BufferStorageProc bufferStorage = hasBufferStorage() ? (BufferStorageProc)load("glBufferStorage") : nullptr;
+	if (bufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_ARRAY_BUFFER, regionBytes * numRegions, nullptr, flags);
+		mapped = (ClothVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionBytes * numRegions, flags);
+		persistent = mapped != nullptr;
+		if (!persistent)
+		{
+			// Storage can't be respecified, start over with a plain buffer
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		}
+	}
+	if (!persistent)
+	{
+		// Allocated once, only ever updated in place
+		glBufferData(GL_ARRAY_BUFFER, regionBytes * numRegions, nullptr, GL_STREAM_DRAW);
+		staging.resize(numVertices);
+	}
+
+	glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(ClothVertex), (void*)0);
+	glVertexAttribPointer(normAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(ClothVertex), (void*)sizeof(glm::vec3));
+	glEnableVertexAttribArray(posAttrib);
+	glEnableVertexAttribArray(normAttrib);
+	return glGetError() == GL_NO_ERROR;
+}
+
+// Needs the context that init ran with to still be current
+void VertexStream::release()
+{
+	for (int r = 0; r < numRegions; r++)
+	{
+		if (fences[r])
+			glDeleteSync(fences[r]);
+		fences[r] = nullptr;
+	}
+	if (buffer)
+	{
+		if (mapped)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	mapped = nullptr;
+	persistent = false;
+	std::vector<ClothVertex>().swap(staging);
+}
+
+ClothVertex* VertexStream::begin()
+{
+	if (!persistent)
+		return staging.data();
+
+	// The GPU is normally done with a region two frames later, so this
+	// rarely waits
+	if (fences[region])
+	{
+		while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fences[region]);
+		fences[region] = nullptr;
+	}
+	return mapped + region * numVertices;
+}
+
+void VertexStream::end()
+{
+	size_t offset = regionBytes * region;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (!persistent)
+		glBufferSubData(GL_ARRAY_BUFFER, offset, regionBytes, staging.data());
+	glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(ClothVertex), (void*)offset);
+	glVertexAttribPointer(normAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(ClothVertex), (void*)(offset + sizeof(glm::vec3)));
+}
+
+void VertexStream::fence()
+{
+	if (persistent)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % numRegions;
+}
@@ -0,0 +1,67 @@
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+// Streams the cloth's interleaved vertices to one GL buffer without
+// reallocating it. The buffer holds three regions used in turn, so the CPU
+// writes one frame while the GPU may still be drawing the last two.
+//
+// With buffer storage (GL 4.4 or ARB_buffer_storage, which Mesa's software
+// GL has too) the buffer is mapped once, persistently, and the cloth writes
+// its vertices straight into it. A fence after each frame's draws keeps the
+// CPU from overwriting a region the GPU has not finished with. Without it,
+// vertices go through a CPU staging copy and glBufferSubData.
+//
+//   ClothVertex* vertices = stream.begin();
+//   cloth->writeVertices(alpha, vertices);
+//   stream.end();          // points the vertex attributes at this region
+//   ... draw ...
+//   stream.fence();
+
+#include <glad/glad.h>
+
+#include "clothData.h"
+
+#include <vector>
+
+class VertexStream
+{
+public:
+	static const int numRegions = 3;
+
+	VertexStream();
+	~VertexStream();
+	VertexStream(const VertexStream&) = delete;
+	VertexStream& operator=(const VertexStream&) = delete;
+
+	// Creates the buffer for numVertices and sets position and normal up as
+	// attributes posAttrib and normAttrib of the bound VAO. load looks up GL
+	// functions glad does not know about. Returns false if GL fails.
+	bool init(int numVertices, GLADloadproc load, unsigned int posAttrib, unsigned int normAttrib);
+	void release();
+
+	// Memory to write this frame's vertices to, waits for the GPU if it is
+	// still reading it
+	ClothVertex* begin();
+	// Hands the vertices to GL and points the attributes at them, needs the
+	// VAO bound
+	void end();
+	// Call once this frame's draws have been issued
+	void fence();
+
+	bool isPersistent() const { return persistent; }
+	size_t getMemoryUsed() const { return regionBytes * numRegions + staging.size() * sizeof(ClothVertex); }
+
+private:
+	unsigned int buffer;
+	unsigned int posAttrib, normAttrib;
+	int numVertices;
+	size_t regionBytes;
+	int region;
+	bool persistent;
+	// Whole buffer when persistently mapped
+	ClothVertex* mapped;
+	std::vector<ClothVertex> staging;
+	GLsync fences[numRegions];
+};
+
+#endif